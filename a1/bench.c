@@ -0,0 +1,278 @@
+/****************************************************************
+*	Author: Nicolas Leo                    						*
+*	Class: CS 1550, 9/17/18                						*
+*	Project 1: Double-Buffered Graphics Library					*
+*	Description: Throughput benchmarks for the library. Runs    *
+*   headless (HEADLESS_BPP=16|24|32) if there's no frame buffer.*
+*   Usage: bench [name ...], no names runs everything.          *
+****************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "graphics.h"
+
+#define BENCH_MS 500 // Each benchmark runs for about this long
+
+static void *buf;
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// 32x32 sprite with a soft round edge & a colorkeyed corner
+static color_t sprite_px[32*32];
+static unsigned char sprite_alpha[32*32];
+
+static void make_sprite(sprite_t *sp, int use_alpha, int colorkey)
+{
+	int x, y;
+	for (y = 0; y < 32; ++y)
+		for (x = 0; x < 32; ++x)
+		{
+			int d2 = (x - 16)*(x - 16) + (y - 16)*(y - 16);
+			sprite_px[y*32 + x] = (x < 4 && y < 4) ? RGB(31, 0, 31) : RGB(x, y*2, 31 - x);
+			sprite_alpha[y*32 + x] = d2 > 256 ? 0 : 255 - d2;
+		}
+	sp->w = sp->h = 32;
+	sp->pixels = sprite_px;
+	sp->alpha = use_alpha ? sprite_alpha : NULL;
+	sp->colorkey = colorkey;
+}
+
+static long sprites(int use_alpha, int colorkey)
+{
+	sprite_t sp;
+	long n = 0;
+	double end = now_ms() + BENCH_MS;
+
+	make_sprite(&sp, use_alpha, colorkey);
+	while (now_ms() < end)
+	{
+		int i;
+		for (i = 0; i < 1000; ++i, ++n)
+			blit_sprite(buf, &sp, (int) (n * 37 % 620) - 10, (int) (n * 53 % 470) - 10);
+	}
+	return n;
+}
+
+static long bench_opaque(void) { return sprites(0, -1); }
+static long bench_colorkey(void) { return sprites(0, RGB(31, 0, 31)); }
+static long bench_alpha(void) { return sprites(1, -1); }
+
+// Returns glyphs drawn
+static long bench_text(void)
+{
+	static const char line[] = "Score: 0123456789 The quick brown fox!";
+	long n = 0;
+	double end = now_ms() + BENCH_MS;
+
+	while (now_ms() < end)
+	{
+		int i;
+		for (i = 0; i < 100; ++i, n += sizeof(line) - 1)
+			draw_text(buf, (i * 13) % 400, (i * 8) % 470, line, 1, RGB(31, 63, 31));
+	}
+	return n;
+}
+
+// Returns triangles drawn, about 2000 pixels each
+static long bench_triangles(void)
+{
+	long n = 0;
+	double end = now_ms() + BENCH_MS;
+
+	while (now_ms() < end)
+	{
+		int i;
+		for (i = 0; i < 1000; ++i, ++n)
+		{
+			int x = (int) (n * 37 % 600), y = (int) (n * 53 % 440);
+			fill_triangle(buf, x, y, x + 60, y + 10, x + 20, y + 70, RGB(0, 63, 0));
+		}
+	}
+	return n;
+}
+
+// Returns circles drawn, radius 20
+static long bench_circles(void)
+{
+	long n = 0;
+	double end = now_ms() + BENCH_MS;
+
+	while (now_ms() < end)
+	{
+		int i;
+		for (i = 0; i < 1000; ++i, ++n)
+			fill_circle(buf, (int) (n * 37 % 640), (int) (n * 53 % 480), 20, RGB(0, 0, 31));
+	}
+	return n;
+}
+
+// Returns anti-aliased lines drawn, about 100 pixels long
+static long bench_aalines(void)
+{
+	long n = 0;
+	double end = now_ms() + BENCH_MS;
+
+	while (now_ms() < end)
+	{
+		int i;
+		for (i = 0; i < 1000; ++i, ++n)
+		{
+			int x = (int) (n * 37 % 540), y = (int) (n * 53 % 440);
+			draw_line_aa(buf, x, y, x + 100, y + 37, RGB(31, 63, 31));
+		}
+	}
+	return n;
+}
+
+// Returns frames blitted, each with a 64x64 square moved
+static long blits(const char *file)
+{
+	long n = 0;
+	double end = now_ms() + BENCH_MS;
+
+	if (file != NULL && record_start(file) != 0) return 0;
+	while (now_ms() < end)
+	{
+		int i;
+		for (i = 0; i < 100; ++i, ++n)
+		{
+			int x = (int) (n * 7 % 576), y = (int) (n * 3 % 416);
+			fill_rect(buf, x, y, 64, 64, (color_t) n);
+			blit(buf);
+		}
+	}
+	if (file != NULL) record_stop();
+	return n;
+}
+
+static long bench_blit(void) { return blits(NULL); }
+static long bench_record(void) { return blits("/dev/null"); }
+
+// 160x120 "sensor thumbnail" for the scaling benchmarks
+static color_t thumb_px[160*120];
+
+static void make_thumb(sprite_t *sp)
+{
+	int x, y;
+	for (y = 0; y < 120; ++y)
+		for (x = 0; x < 160; ++x)
+			thumb_px[y*160 + x] = RGB(x * 31 / 159, (x ^ y) & 63, y * 31 / 119);
+	sp->w = 160; sp->h = 120;
+	sp->pixels = thumb_px;
+	sp->alpha = NULL;
+	sp->colorkey = -1;
+}
+
+// Returns pixels drawn, the thumbnail scaled by factor (angle < 0) or turned
+static long scaled(double factor, double angle, int filter)
+{
+	sprite_t sp;
+	long n = 0;
+	int w = (int) (160 * factor), h = (int) (120 * factor);
+	double end = now_ms() + BENCH_MS;
+
+	make_thumb(&sp);
+	while (now_ms() < end)
+	{
+		int i;
+		for (i = 0; i < 10; ++i, n += (long) w * h)
+			if (angle < 0)
+				blit_scaled(buf, &sp, (int) (n % 7), 0, w, h, filter);
+			else
+				blit_transformed(buf, &sp, 320, 240, factor, angle + i * 0.1, filter);
+	}
+	return n;
+}
+
+static long bench_near_half(void) { return scaled(0.5, -1, SAMPLE_NEAREST); }
+static long bench_near_2x(void)   { return scaled(2, -1, SAMPLE_NEAREST); }
+static long bench_near_4x(void)   { return scaled(4, -1, SAMPLE_NEAREST); }
+static long bench_bi_half(void)   { return scaled(0.5, -1, SAMPLE_BILINEAR); }
+static long bench_bi_2x(void)     { return scaled(2, -1, SAMPLE_BILINEAR); }
+static long bench_bi_4x(void)     { return scaled(4, -1, SAMPLE_BILINEAR); }
+static long bench_rotate(void)    { return scaled(2, 0.3, SAMPLE_NEAREST); }
+static long bench_rotate_bi(void) { return scaled(2, 0.3, SAMPLE_BILINEAR); }
+
+// Returns frames built from 3 layers (background, sprites & HUD, mostly keyed)
+static long bench_composite(void)
+{
+	void *layers[3] = {acquire_buffer(), acquire_buffer(), acquire_buffer()};
+	long n = 0;
+	double end = now_ms() + BENCH_MS;
+	int i;
+
+	if (layers[0] == NULL || layers[1] == NULL || layers[2] == NULL) return 0;
+	fill_rect(layers[0], 0, 0, 640, 480, RGB(0, 20, 31));
+	for (i = 1; i < 3; ++i) fill_rect(layers[i], 0, 0, 640, 480, RGB(31, 0, 31));
+	for (i = 0; i < 50; ++i) fill_circle(layers[1], i * 97 % 640, i * 61 % 480, 16, RGB(31, 63, 0));
+	fill_rect(layers[2], 0, 0, 640, 24, RGB(0, 0, 0));
+	draw_text(layers[2], 4, 8, "Score: 0123456789", 1, RGB(31, 63, 31));
+
+	while (now_ms() < end)
+		for (i = 0; i < 10; ++i, ++n)
+			composite(buf, layers, 3, RGB(31, 0, 31));
+	for (i = 0; i < 3; ++i) release_buffer(layers[i]);
+	return n;
+}
+
+static struct
+{
+	const char *name, *unit;
+	long (*run)(void);
+} benches[] =
+{
+	{"opaque",   "sprites", bench_opaque},
+	{"colorkey", "sprites", bench_colorkey},
+	{"alpha",    "sprites", bench_alpha},
+	{"text",     "glyphs",  bench_text},
+	{"triangles", "triangles", bench_triangles},
+	{"circles",  "circles", bench_circles},
+	{"aalines",  "lines",   bench_aalines},
+	{"near0.5x", "pixels",  bench_near_half},
+	{"near2x",   "pixels",  bench_near_2x},
+	{"near4x",   "pixels",  bench_near_4x},
+	{"bilin0.5x", "pixels", bench_bi_half},
+	{"bilin2x",  "pixels",  bench_bi_2x},
+	{"bilin4x",  "pixels",  bench_bi_4x},
+	{"rotate",   "pixels",  bench_rotate},	// 2x, turned
+	{"rotate_bi", "pixels", bench_rotate_bi},
+	{"composite", "frames", bench_composite},
+	{"blit",     "frames",  bench_blit},
+	{"record",   "frames",  bench_record}, // blit, recorded to /dev/null
+};
+
+#define NBENCH (int) (sizeof(benches) / sizeof(benches[0]))
+
+int main(int argc, char **argv)
+{
+	double rate[NBENCH];
+	int i, j, ran[NBENCH] = {0};
+
+	init_graphics();
+	buf = new_offscreen_buffer();
+	for (i = 0; i < NBENCH; ++i)
+	{
+		double start;
+		long n;
+
+		for (j = 1; j < argc && strcmp(argv[j], benches[i].name) != 0; ++j);
+		if (argc > 1 && j == argc) continue;
+
+		clear_screen(buf);
+		start = now_ms();
+		n = benches[i].run();
+		rate[i] = n / ((now_ms() - start) / 1000.0);
+		ran[i] = 1;
+	}
+	exit_graphics();
+
+	for (i = 0; i < NBENCH; ++i)
+		if (ran[i]) printf("%-10s %12.0f %s/s\n", benches[i].name, rate[i], benches[i].unit);
+	return 0;
+}
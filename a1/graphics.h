@@ -4,15 +4,87 @@
 *	Project 1: Double-Buffered Graphics Library					*
 *	Description: Header file for library.c                      *
 ****************************************************************/
+#ifndef GRAPHICS_H
+#define GRAPHICS_H
 
+// Colors are always passed around as RGB565. The library converts them to
+// whatever the frame buffer actually uses (16, 24 or 32 bpp) when drawing.
 typedef unsigned short int color_t;
-#define RGB(R, G, B) ((((R << 11))|(G << 5))|B)
+#define RGB(R, G, B) ((((R) << 11)|((G) << 5))|(B))
+// Keys reported by wait_event()/frame_event() besides plain characters
+#define KEY_ESC   27
+#define KEY_UP    0x100
+#define KEY_DOWN  0x101
+#define KEY_RIGHT 0x102
+#define KEY_LEFT  0x103
+
+typedef struct
+{
+	int key;	// Character or one of the KEY_ codes
+} event_t;
+
+// A w x h image for blit_sprite()
+typedef struct
+{
+	int w, h;
+	color_t *pixels;		// w*h RGB565 pixels, row by row
+	unsigned char *alpha;	// w*h opacity values (0-255), NULL if opaque
+	int colorkey;			// Color that isn't drawn, -1 for none
+} sprite_t;
+
 void init_graphics();
 void exit_graphics();
 char getkey();
 void sleep_ms(long ms);
+int wait_event(event_t *ev, long timeout_ms);
+void frame_rate(long period_ms);
+int frame_event(event_t *ev);
+void frame_wait();
 void clear_screen(void *img);
 void draw_pixel(void *img, int x, int y, color_t color);
 void draw_line(void *img, int x1, int y1, int x2, int y2, color_t c); 
-void *new_offscreen_buffer();
-void blit(void *src);
\ No newline at end of file
+void *new_offscreen_buffer();	// Cleared buffer from the pool
+// Off-screen buffers are pooled: release_buffer() hands one back for the next
+// acquire_buffer() to reuse as it is, exit_graphics() frees them all.
+void *acquire_buffer();
+void release_buffer(void *img);
+// dst = layers[0] with the pixels of layers[1..n-1] that aren't key on top
+void composite(void *dst, void *const *layers, int n, color_t key);
+void blit(void *src);
+void blit_rect(void *src, int x, int y, int w, int h); // Just that part of src
+
+void fill_rect(void *img, int x, int y, int w, int h, color_t c);
+void fill_triangle(void *img, int x1, int y1, int x2, int y2, int x3, int y3, color_t c);
+void fill_polygon(void *img, const int *x, const int *y, int n, color_t c);
+void fill_circle(void *img, int cx, int cy, int r, color_t c);
+void fill_ellipse(void *img, int cx, int cy, int rx, int ry, color_t c);
+void draw_line_aa(void *img, int x1, int y1, int x2, int y2, color_t c);
+void blit_sprite(void *dst, const sprite_t *sprite, int x, int y);
+void draw_text(void *img, int x, int y, const char *text, int scale, color_t c);
+
+// Sampling for blit_scaled() & blit_transformed() (link with -lm)
+#define SAMPLE_NEAREST  0
+#define SAMPLE_BILINEAR 1
+void blit_scaled(void *dst, const sprite_t *sprite, int x, int y, int w, int h, int filter);
+void blit_transformed(void *dst, const sprite_t *sprite, int cx, int cy,
+	double scale, double angle, int filter); // angle in radians, clockwise
+
+// Batched drawing. Between begin_batch() and end_batch() the drawing calls on
+// img are recorded, then rasterized in parallel tiles. Link with -pthread.
+void begin_batch(void *img);
+void end_batch();
+void set_render_threads(int n);
+
+// Cell d (0..4^n-1) of the order n Hilbert curve, the order batches render tiles in
+void hilbert_d2xy(int n, int d, int *x, int *y);
+
+// Recording. Between record_start() & record_stop() every blit() & blit_rect()
+// also goes to file, encoded on a thread of its own (play.c plays it back).
+// record_start() returns 0 or -1; record_stop() the frames written or -1.
+int record_start(const char *file);
+long record_stop();
+
+// Converts n RGB565 colors into the frame buffer's native pixel format
+void convert_colors(void *dst, const color_t *src, int n);
+
+#endif
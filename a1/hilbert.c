@@ -3,10 +3,39 @@ This file draws a hilbert space filling curve. Initially it starts with
 a simple U shape, but typing a + will increase the amount of space it has
 to fill and will result in a fun curve. Eventually the lines it draws will
 be length 1, and the whole 256x256 region will appear to be solid red.
+
+The curve is generated without recursion: the cells of order n are the
+cells of order n-1, copied into the four quadrants with the rotations of the
+usual d -> (x, y) mapping. Each order is built from the one before & cached,
+along with its corners, so drawing it is one fill_rect per straight span.
+
+Running it as "hilbert -b [order]" instead times the original recursive
+turtle against the cached spans, building the curves, and drawing through the
+batched renderer with 1..N threads, then prints the results.
 */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include "graphics.h"
 
+#define BENCH_REPS 20
+#define MAX_ORDER 8 // Cells are 1 pixel apart, the region is solid
+
+// One order of the curve: its 4^n cells in curve order & the corners where it
+// turns (plus both ends), so consecutive corners bound one straight span
+struct curve
+{
+	int ncells, ncorners;
+	unsigned short *x, *y;
+	unsigned short *cx, *cy;
+};
+
+static struct curve cache[MAX_ORDER + 1];
+
+// The original recursive turtle, kept for the benchmark
 int direction = 0;
 int curr_x = 0;
 int curr_y = 0;
@@ -57,14 +86,169 @@ void hilbert_recurse(void *img, int n, int parity, int dist)
 	turn_left(parity * 90);
 }
 
-void hilbert(void *img, int n, int parity)
+void hilbert_recursive(void *img, int n)
+{
+	curr_x = curr_y = direction = 0;
+	hilbert_recurse(img, n, +1, 479 / (1 << n));
+}
+
+/*
+	Returns order n, building it from order n-1 (itself cached) the first time.
+	Quadrant q of order n is order n-1 moved by s = 2^(n-1) in x if rx & in y if
+	ry, after a transpose when ry is 0 (also mirrored when rx is 1 too).
+*/
+static const struct curve *get_curve(int n)
+{
+	struct curve *c = &cache[n];
+	const struct curve *prev;
+	int q, i, k, s;
+
+	if (c->ncells > 0) return c;
+	c->ncells = 1 << (2*n);
+	c->x = malloc(c->ncells * sizeof(unsigned short));
+	c->y = malloc(c->ncells * sizeof(unsigned short));
+	c->cx = malloc(c->ncells * sizeof(unsigned short));
+	c->cy = malloc(c->ncells * sizeof(unsigned short));
+	if (c->x == NULL || c->y == NULL || c->cx == NULL || c->cy == NULL)
+	{
+		fputs("Out of memory\n", stderr);
+		exit(1);
+	}
+
+	if (n == 0)
+		c->x[0] = c->y[0] = 0;
+	else
+	{
+		prev = get_curve(n - 1);
+		s = 1 << (n - 1);
+		for (q = 0, k = 0; q < 4; ++q)
+		{
+			int rx = (q >> 1) & 1, ry = (q ^ rx) & 1;
+			for (i = 0; i < prev->ncells; ++i, ++k)
+			{
+				int x = prev->x[i], y = prev->y[i];
+				if (ry == 0)
+				{
+					int t;
+					if (rx) { x = s - 1 - x; y = s - 1 - y; }
+					t = x; x = y; y = t;
+				}
+				c->x[k] = x + s*rx;
+				c->y[k] = y + s*ry;
+			}
+		}
+	}
+
+	// Keep the ends & every cell where the direction changes
+	c->cx[0] = c->x[0]; c->cy[0] = c->y[0];
+	c->ncorners = 1;
+	for (i = 1; i < c->ncells; ++i)
+	{
+		if (i + 1 < c->ncells &&
+			c->x[i] - c->x[i-1] == c->x[i+1] - c->x[i] &&
+			c->y[i] - c->y[i-1] == c->y[i+1] - c->y[i])
+			continue;
+		c->cx[c->ncorners] = c->x[i];
+		c->cy[c->ncorners++] = c->y[i];
+	}
+	return c;
+}
+
+static void free_curves(void)
+{
+	int n;
+	for (n = 0; n <= MAX_ORDER; ++n)
+	{
+		free(cache[n].x); free(cache[n].y); free(cache[n].cx); free(cache[n].cy);
+		memset(&cache[n], 0, sizeof(cache[n]));
+	}
+}
+
+// Draws order n from its cached spans, one fill_rect per straight span
+void hilbert(void *img, int n)
 {
-	hilbert_recurse(img, n, parity, 479 / (1 << n));
+	const struct curve *c = get_curve(n);
+	int dist = 479 / (1 << n), i;
+
+	for (i = 1; i < c->ncorners; ++i)
+	{
+		int x0 = c->cx[i-1] * dist, y0 = c->cy[i-1] * dist,
+			x1 = c->cx[i] * dist, y1 = c->cy[i] * dist;
+		fill_rect(img, x0 < x1 ? x0 : x1, y0 < y1 ? y0 : y1,
+				  abs(x1 - x0) + 1, abs(y1 - y0) + 1, RGB(31, 0, 0));
+	}
+}
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Draws the order n curve BENCH_REPS times with draw, batched with the given
+// number of threads (0 = draw directly). Returns ms per frame.
+static double time_curve(void *buf, int n, int threads, void (*draw)(void *, int))
+{
+	int r;
+	double start = now_ms();
+
+	for (r = 0; r < BENCH_REPS; ++r)
+	{
+		clear_screen(buf);
+		if (threads > 0)
+		{
+			set_render_threads(threads);
+			begin_batch(buf);
+		}
+		draw(buf, n);
+		if (threads > 0) end_batch();
+	}
+	return (now_ms() - start) / BENCH_REPS;
+}
+
+static void benchmark(int n)
+{
+	int cpus = (int) sysconf(_SC_NPROCESSORS_ONLN), t, r;
+	double recursive, direct, build, batched[64], start;
+
+	if (cpus > 64) cpus = 64;
+	if (n < 1 || n > MAX_ORDER) n = MAX_ORDER;
+	init_graphics();
+	void *buf = new_offscreen_buffer();
+
+	start = now_ms(); // Orders 0..n from nothing, as the first '+'s would
+	for (r = 0; r < BENCH_REPS; ++r)
+	{
+		free_curves();
+		get_curve(n);
+	}
+	build = (now_ms() - start) / BENCH_REPS;
+
+	recursive = time_curve(buf, n, 0, hilbert_recursive);
+	direct = time_curve(buf, n, 0, hilbert);
+	for (t = 1; t <= cpus; ++t)
+		batched[t - 1] = time_curve(buf, n, t, hilbert);
+	exit_graphics();
+
+	printf("Hilbert order %d, %d segments in %d spans, %d frames each\n", n,
+		(1 << (2*n)) - 1, get_curve(n)->ncorners - 1, BENCH_REPS);
+	printf("recursive:  %8.3f ms/frame\n", recursive);
+	printf("spans:      %8.3f ms/frame  (%.2fx), building the curve %.3f ms once\n",
+		direct, recursive / direct, build);
+	for (t = 1; t <= cpus; ++t)
+		printf("%2d threads: %8.3f ms/frame  (%.2fx vs 1 thread)\n", t,
+			batched[t - 1], batched[0] / batched[t - 1]);
 }
 
 int main(int argc, char **argv)
 {
-	int i;
+	if (argc > 1 && strcmp(argv[1], "-b") == 0)
+	{
+		benchmark(argc > 2 ? atoi(argv[2]) : MAX_ORDER);
+		free_curves();
+		return 0;
+	}
 
 	init_graphics();
 
@@ -75,21 +259,18 @@ int main(int argc, char **argv)
 	int n = 1;
 
 	//Draw the simple U shape
-	hilbert(buf, n, +1);
+	hilbert(buf, n);
 	blit(buf);
 
 	do {
-		curr_x = 0;
-		curr_y = 0;
-
 		key = getkey();
 		if (key == 'q')
 			break;
 		//Make it more interesting
-		else if (key == '+') {
+		else if (key == '+' && n < MAX_ORDER) {
 			n++;
 			clear_screen(buf);
-			hilbert(buf, n, +1);
+			hilbert(buf, n);
 			blit(buf);
 		}
 		sleep_ms(200);
@@ -97,6 +278,7 @@ int main(int argc, char **argv)
 	while (1);
 
 	exit_graphics();
+	free_curves();
 	return 0;
 
 }
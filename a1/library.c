@@ -8,51 +8,410 @@
 
 
 
+#define _GNU_SOURCE	// ppoll()
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
 #include <fcntl.h>
 #include <sys/mman.h> 	//Needed for mmap & munmap functions
 #include <sys/ioctl.h>
 #include <linux/fb.h> 	//needed for fbvar & fbfix structs
-#include <sys/select.h> //needed to check if a device is ready w/out blocking
+#include <poll.h> 		//needed to wait for input w/out busy polling
+#include <errno.h>
 #include <termios.h>	//Needed for termios struct & constants
 #include <unistd.h>
 #include <time.h> 		// Needed for timespec struct
+#include <math.h>		// cos() & sin() for blit_transformed (link with -lm)
+#include <pthread.h>	// Worker pool for batched drawing (link with -pthread)
+#ifdef __SSE2__
+#include <emmintrin.h>	// SSE2 intrinsics for bulk color conversion
+#endif
+#include "graphics.h"
 
-typedef unsigned short color_t;
+// Used when /dev/fb0 can't be opened (e.g. over ssh). Everything is drawn to
+// anonymous memory instead so programs still run. HEADLESS_BPP picks the depth.
+#define HEADLESS_XRES 640
+#define HEADLESS_YRES 480
+
+#define TILE_SIZE 64			// Batched drawing is rasterized in 64x64 tiles
+#define MAX_RENDER_THREADS 64
+#define BATCH_MIN_CMDS 4096		// Smaller batches are drawn in order, without tiles
+#define MAX_BUFFERS 64			// Off-screen buffers alive at once
+#define HUGE_PAGE (2L << 20)	// Buffers this big or more are aligned for huge pages
 
 static unsigned char initialized = 0; 	// Indicates if the graphics are initialized
 
 static char key = 0; 					// Holds a single character input from the keyboard
 
 static int fbuff_fd, 					// Frame buffer file descriptor 
-		   kb,							// Keyboard file descriptor
 		   xres,						// Virtual xres
-		   yres;						// Virtual yres
+		   yres,						// Virtual yres
+		   bytespp,						// Bytes per pixel (2, 3 or 4)
+		   stride;						// Bytes per line (fbfix.line_length)
 
 static long sizetommap; 				// Total size of the off-screen buffer in bytes
 
 static void * fbuff; 					// Address of mmapped off-screen buffer
-static void * osbuff = NULL; 			// Address of mmapped off-screen buffer
+
+// Off-screen buffer pool, see acquire_buffer()
+static struct
+{
+	char *p;
+	char used;
+} pool[MAX_BUFFERS];
+static int npool = 0;
+static long bufsize;					// Bytes mapped per buffer, sizetommap rounded up
 
 static struct fb_var_screeninfo fbvar;	// Frame buffer variables
 static struct fb_fix_screeninfo fbfix;	// Frame buffer variables
 static struct termios term;				// Needed for terminal settings
 
+/*
+	Pixel pipelines. Every supported depth gets its own copy of the per-pixel
+	routines (generated by PIXEL_PIPELINE) so the inner loops never have to
+	check the format. init_graphics() picks the matching set once and the
+	public functions only convert the color and jump through the table.
+*/
+#define STORE16(p, v) (*(uint16_t *)(p) = (uint16_t)(v))
+#define STORE24(p, v) ((p)[0] = (char)(v), (p)[1] = (char)((v) >> 8), \
+						(p)[2] = (char)((v) >> 16))
+#define STORE32(p, v) (*(uint32_t *)(p) = (uint32_t)(v))
+
+#define PIXEL_PIPELINE(BPP, BYTES)											\
+static void pixel##BPP(char *img, int x, int y, unsigned int px)			\
+{																			\
+	STORE##BPP(img + y*stride + x*BYTES, px);								\
+}																			\
+																			\
+/* Implementation of Bresenham's Line Plotting Algorithm					\
+   Source: https://gist.github.com/bert/1085538 */							\
+static void line##BPP(char *img, int x1, int y1, int x2, int y2,			\
+					  unsigned int px)										\
+{																			\
+	int dx =  abs (x2 - x1),												\
+		dy = -abs (y2 - y1),												\
+		err = dx + dy, 														\
+		e2, /* error value e_xy */											\
+		n = dx > -dy ? dx : -dy, /* pixels left after this one */			\
+		stepx = x1 < x2 ? BYTES : -BYTES,									\
+		stepy = y1 < y2 ? stride : -stride;									\
+	char *p = img + y1*stride + x1*BYTES;									\
+																			\
+	while(1)																\
+	{ 																		\
+		STORE##BPP(p, px); /* Draw the pixel */								\
+		if (n-- == 0) break; /* All pixels drawn */							\
+		e2 = err << 1; /* 2 * err */										\
+		if (e2 >= dy) { err += dy; p += stepx; } /* e_xy+e_x > 0 */			\
+		if (e2 <= dx) { err += dx; p += stepy; } /* e_xy+e_y < 0 */			\
+	}																		\
+}																			\
+																			\
+static void span##BPP(char *p, int n, unsigned int px)						\
+{																			\
+	for (; n > 0; --n, p += BYTES)											\
+		STORE##BPP(p, px);													\
+}																			\
+																			\
+/* Same walk as line##BPP but only the pixels inside the tile				\
+   [tx0, tx1) x [ty0, ty1) are stored. Stops once the line has left it. */	\
+static void clipline##BPP(char *img, int x1, int y1, int x2, int y2,		\
+						  unsigned int px, int tx0, int ty0, int tx1, int ty1)	\
+{																			\
+	int dx =  abs (x2 - x1), sx = x1 < x2 ? 1 : -1,							\
+		dy = -abs (y2 - y1), sy = y1 < y2 ? 1 : -1,							\
+		err = dx + dy, e2,													\
+		n = dx > -dy ? dx : -dy;											\
+																			\
+	while(1)																\
+	{																		\
+		if (x1 >= tx0 && x1 < tx1 && y1 >= ty0 && y1 < ty1)					\
+			STORE##BPP(img + y1*stride + x1*BYTES, px);						\
+		else if ((sx > 0 ? x1 >= tx1 : x1 < tx0) ||							\
+				 (sy > 0 ? y1 >= ty1 : y1 < ty0)) break; /* Past the tile */	\
+		if (n-- == 0) break;												\
+		e2 = err << 1;														\
+		if (e2 >= dy) { err += dy; x1 += sx; }								\
+		if (e2 <= dx) { err += dx; y1 += sy; }								\
+	}																		\
+}
+
+PIXEL_PIPELINE(16, 2)
+PIXEL_PIPELINE(24, 3)
+PIXEL_PIPELINE(32, 4)
+
+struct pixel_ops
+{
+	void (*pixel)(char *img, int x, int y, unsigned int px);
+	void (*line)(char *img, int x1, int y1, int x2, int y2, unsigned int px);
+	void (*span)(char *p, int n, unsigned int px);
+	void (*clipline)(char *img, int x1, int y1, int x2, int y2, unsigned int px,
+					 int tx0, int ty0, int tx1, int ty1);
+	void (*convert)(void *dst, const color_t *src, int n);
+	void (*unconvert)(color_t *dst, const void *src, int n);
+};
+
+static struct pixel_ops ops;			// Pipeline for the current bit depth
+
+/*
+	Command buffer used between begin_batch() & end_batch(). Pixels and
+	horizontal/vertical lines are stored as rectangles, everything else as a
+	line. Commands are binned into tiles and each tile is rasterized by exactly
+	one thread, in recording order, so the workers never need a lock.
+*/
+#define CMD_RECT 0
+#define CMD_LINE 1
+
+struct draw_cmd
+{
+	int type, x1, y1, x2, y2;	// Rect: [x1, x2] x [y1, y2], inclusive
+	unsigned int px;			// Native pixel value
+};
+
+static char *batch_img = NULL;			// Buffer being recorded, NULL if none
+static struct draw_cmd *cmds = NULL;	// Recorded commands
+static int ncmds, cmdcap;
+
+static int tiles_x, tiles_y, ntiles;	// Tile grid for the current batch
+static int *bin_start = NULL,			// Tile t uses bins[bin_start[t]..bin_start[t+1])
+		   *bins = NULL,				// Command indices, grouped by tile
+		   *tile_order = NULL,			// Tiles in the order they're handed out
+		   bincap;
+static volatile int next_tile;			// Next tile_order entry to hand out
+
+// Worker pool. The calling thread always renders too, so n threads = n-1 workers
+static pthread_t workers[MAX_RENDER_THREADS];
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_wake = PTHREAD_COND_INITIALIZER,
+					  pool_done = PTHREAD_COND_INITIALIZER;
+static int pool_size = 0,				// Running workers
+		   pool_busy,					// Workers still rendering this batch
+		   pool_gen = 0,				// Bumped to start a batch
+		   pool_quit = 0,
+		   render_threads = 0;			// Requested threads, 0 = one per CPU
+
+static color_t *rowbuf = NULL;			// One screen row of RGB565, for blending
+
+// blit_scaled()'s source column for each destination column, kept for the
+// next call with the same widths & filter
+static struct
+{
+	int sw, dw, filter;
+	int *x0;
+	unsigned short *fx;		// Weight of the column right of x0, 0..255
+} colmap = {0, 0, -1, NULL, NULL};
+
+/*
+	Frame recorder, see record_start(). The render loop fills the ring's
+	slots & the encoder thread empties them, each side moving its own index
+	under rec_lock. Only the encoder touches the frames & the file.
+*/
+#define REC_SLOTS 4
+
+struct rec_slot
+{
+	char *pixels;				// Screen sized, native format, only the rect is valid
+	int x, y, w, h;				// What was blitted
+	unsigned int ms;			// When, since record_start()
+};
+
+static struct rec_slot rec_ring[REC_SLOTS];
+static unsigned int rec_head,			// Next slot to fill
+					rec_tail;			// Next slot to encode
+static char rec_on = 0,					// Recording
+			rec_quit,					// Encode what's queued, then stop
+			rec_resync,					// A blit was dropped, queue the whole screen next
+			rec_first,					// Write every tile of the next frame
+			rec_error;					// A write failed
+static pthread_t rec_thread;
+static pthread_mutex_t rec_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rec_wake = PTHREAD_COND_INITIALIZER;
+static struct timespec rec_start;
+static FILE *rec_file;
+static color_t *rec_cur = NULL,			// Screen as of the last slot, RGB565
+			   *rec_prev = NULL,		// Screen as of the last frame written
+			   *rec_tile = NULL;		// One tile's pixels, packed
+static unsigned char *rec_out = NULL;	// Frame being encoded
+static long rec_frames;
+
+static void record(int type, int x1, int y1, int x2, int y2, unsigned int px);
+static void stop_workers(void);
+static void capture(const char *src, int x, int y, int w, int h);
+
+/*
+	RGB565 -> native pixel. The channel positions & widths come from fbvar so
+	BGR panels and 5-5-5 modes are handled too. Called once per drawing call,
+	never per pixel.
+*/
+static unsigned int to_native(color_t c)
+{
+	unsigned int r = (c >> 11) & 0x1f, g = (c >> 5) & 0x3f, b = c & 0x1f;
+
+	// Widen to 8 bits by replicating the high bits, then cut to the panel's width
+	r = (r << 3) | (r >> 2);
+	g = (g << 2) | (g >> 4);
+	b = (b << 3) | (b >> 2);
+
+	return  ((r >> (8 - fbvar.red.length))   << fbvar.red.offset)   |
+			((g >> (8 - fbvar.green.length)) << fbvar.green.offset) |
+			((b >> (8 - fbvar.blue.length))  << fbvar.blue.offset);
+}
+
+// Generic bulk conversion, works for any depth & channel layout
+static void convert_any(void *dst, const color_t *src, int n)
+{
+	char *p = dst;
+	int i;
+	for (i = 0; i < n; ++i, p += bytespp)
+	{
+		unsigned int px = to_native(src[i]);
+		if (bytespp == 2)		STORE16(p, px);
+		else if (bytespp == 3)	STORE24(p, px);
+		else					STORE32(p, px);
+	}
+}
+
+// 16 bpp RGB565 panels need no conversion at all
+static void convert_copy(void *dst, const color_t *src, int n)
+{
+	memcpy(dst, src, n * sizeof(color_t));
+}
+
+// RGB565 -> XRGB8888, 8 pixels per step with SSE2 when available
+static void convert_xrgb(void *dst, const color_t *src, int n)
+{
+	uint32_t *out = dst;
+	int i = 0;
+#ifdef __SSE2__
+	const __m128i m5 = _mm_set1_epi16(0x1f), m6 = _mm_set1_epi16(0x3f);
+	for (; i + 8 <= n; i += 8)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+		__m128i r = _mm_and_si128(_mm_srli_epi16(v, 11), m5);
+		__m128i g = _mm_and_si128(_mm_srli_epi16(v, 5), m6);
+		__m128i b = _mm_and_si128(v, m5);
+
+		r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+		g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+		b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+
+		// Low half of each pixel is G:B, high half is 0:R
+		__m128i gb = _mm_or_si128(_mm_slli_epi16(g, 8), b);
+		_mm_storeu_si128((__m128i *) (out + i),     _mm_unpacklo_epi16(gb, r));
+		_mm_storeu_si128((__m128i *) (out + i + 4), _mm_unpackhi_epi16(gb, r));
+	}
+#endif
+	for (; i < n; ++i)
+		out[i] = to_native(src[i]);
+}
+
+// Native -> RGB565, the reverse of convert_any. Used when blending.
+static void unconvert_any(color_t *dst, const void *src, int n)
+{
+	const unsigned char *p = src;
+	int i;
+	for (i = 0; i < n; ++i, p += bytespp)
+	{
+		unsigned int v = bytespp == 2 ? *(const uint16_t *) p :
+						 bytespp == 3 ? (unsigned int) (p[0] | p[1] << 8 | p[2] << 16) :
+						 *(const uint32_t *) p,
+			r = ((v >> fbvar.red.offset)   << (8 - fbvar.red.length))   & 0xff,
+			g = ((v >> fbvar.green.offset) << (8 - fbvar.green.length)) & 0xff,
+			b = ((v >> fbvar.blue.offset)  << (8 - fbvar.blue.length))  & 0xff;
+		dst[i] = (r >> 3) << 11 | (g >> 2) << 5 | b >> 3;
+	}
+}
+
+static void unconvert_copy(color_t *dst, const void *src, int n)
+{
+	memcpy(dst, src, n * sizeof(color_t));
+}
+
+static void unconvert_xrgb(color_t *dst, const void *src, int n)
+{
+	const uint32_t *in = src;
+	int i;
+	for (i = 0; i < n; ++i)
+		dst[i] = ((in[i] >> 8) & 0xf800) | ((in[i] >> 5) & 0x07e0) | ((in[i] >> 3) & 0x1f);
+}
+
 void init_graphics()
 {
+	char *bpp, *rec_path;
 	fbuff_fd = open ("/dev/fb0", O_RDWR);	//open the frame buffer
 
-	ioctl (fbuff_fd, FBIOGET_VSCREENINFO, &fbvar); // Get current fbvar for y-resolution
-	ioctl (fbuff_fd, FBIOGET_FSCREENINFO, &fbfix); // Get current fbfix for bit depth
+	if (fbuff_fd > -1)
+	{
+		ioctl (fbuff_fd, FBIOGET_VSCREENINFO, &fbvar); // Get current fbvar for y-resolution
+		ioctl (fbuff_fd, FBIOGET_FSCREENINFO, &fbfix); // Get current fbfix for bit depth
+	}
+	else // No frame buffer, fake one with the usual channel layout
+	{
+		fbvar.xres_virtual = HEADLESS_XRES;
+		fbvar.yres_virtual = HEADLESS_YRES;
+		fbvar.bits_per_pixel = (bpp = getenv("HEADLESS_BPP")) ? atoi(bpp) : 16;
+		if (fbvar.bits_per_pixel == 16)
+		{
+			fbvar.red.offset = 11; fbvar.green.offset = 5; fbvar.blue.offset = 0;
+			fbvar.red.length = 5;  fbvar.green.length = 6; fbvar.blue.length = 5;
+		}
+		else
+		{
+			fbvar.bits_per_pixel = fbvar.bits_per_pixel == 24 ? 24 : 32;
+			fbvar.red.offset = 16; fbvar.green.offset = 8; fbvar.blue.offset = 0;
+			fbvar.red.length = 8;  fbvar.green.length = 8; fbvar.blue.length = 8;
+		}
+		fbfix.line_length = HEADLESS_XRES * (fbvar.bits_per_pixel / 8);
+	}
 
 	xres = fbvar.xres_virtual;
 	yres = fbvar.yres_virtual;
+	bytespp = fbvar.bits_per_pixel / 8;
+	stride = fbfix.line_length;
+
+	// Pick the pixel pipeline for this depth
+	if (bytespp == 2)
+	{
+		ops.pixel = pixel16; ops.line = line16; ops.span = span16;
+		ops.clipline = clipline16;
+		ops.convert = fbvar.red.offset == 11 && fbvar.green.length == 6 ?
+			convert_copy : convert_any;
+		ops.unconvert = ops.convert == convert_copy ? unconvert_copy : unconvert_any;
+	}
+	else if (bytespp == 3)
+	{
+		ops.pixel = pixel24; ops.line = line24; ops.span = span24;
+		ops.clipline = clipline24;
+		ops.convert = convert_any;
+		ops.unconvert = unconvert_any;
+	}
+	else if (bytespp == 4)
+	{
+		ops.pixel = pixel32; ops.line = line32; ops.span = span32;
+		ops.clipline = clipline32;
+		ops.convert = fbvar.red.offset == 16 && fbvar.green.offset == 8 &&
+			fbvar.blue.offset == 0 && fbvar.green.length == 8 ?
+			convert_xrgb : convert_any;
+		ops.unconvert = ops.convert == convert_xrgb ? unconvert_xrgb : unconvert_any;
+	}
+	else // 8 bpp palettes & the like, the pipelines would write past each pixel
+	{
+		write(2, "Unsupported frame buffer depth\n", 31);
+		if (fbuff_fd > -1) close(fbuff_fd);
+		return;
+	}
 
 	//lines*bytes/line = byte size off-screen buffer
 	sizetommap = yres * fbfix.line_length; // In bytes
 
 	//Create off-screen buffer
-	fbuff = mmap(NULL, sizetommap, PROT_READ|PROT_WRITE, MAP_SHARED, fbuff_fd, 0);
+	if (fbuff_fd > -1)
+		fbuff = mmap(NULL, sizetommap, PROT_READ|PROT_WRITE, MAP_SHARED, fbuff_fd, 0);
+	else
+		fbuff = mmap(NULL, sizetommap, PROT_READ|PROT_WRITE,
+			MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
 	write(1, "\e[?25l", 6);  	// hide cursor
 	write(1, "\033[2J", 4); 	// Clear the standard output (1)
 
@@ -61,12 +420,18 @@ void init_graphics()
 	ioctl (0, TCSETS, &term); 	//Set new termios settings
 
 	initialized = 1; //Used later to signal that initialization complete
+
+	// Any program can be recorded without changing it
+	if ((rec_path = getenv("FB_RECORD")) != NULL) record_start(rec_path);
 }
 
 void exit_graphics()
 {
+	int i;
+
 	if (initialized) // Only do the following if init_graphics successfully called
 	{
+		record_stop();
 		write(1, "\033[2J", 4); 	// Clear the standard output (1)
 		write(1,"\e[?25h", 6);      // display cursor
 
@@ -75,111 +440,1803 @@ void exit_graphics()
 
 		munmap(fbuff, sizetommap); 		 // Delete memory mapping from initialization 
 
-		// Delete memory mapping from new_offscreen_buffer
-		if (osbuff != NULL) munmap(osbuff, sizetommap); 
+		// Delete the off-screen buffers, released or not
+		for (i = 0; i < npool; ++i) munmap(pool[i].p, bufsize);
+		npool = 0;
+
+		if (fbuff_fd > -1) close(fbuff_fd); 	// Close the frame buffer
+
+		// Shut down the render workers & free the command buffer
+		stop_workers();
+		free(cmds); free(bins); free(bin_start); free(rowbuf);
+		free(tile_order);
+		free(colmap.x0); free(colmap.fx);
+		colmap.x0 = NULL; colmap.fx = NULL; colmap.filter = -1;
+		cmds = NULL; bins = bin_start = tile_order = NULL; rowbuf = NULL;
+		ncmds = cmdcap = bincap = 0;
+		batch_img = NULL;
 
-		close(fbuff_fd); 			// Close the frame buffer
 		initialized = 0;
 	}
 } 
  
 
 /*
-	This function gets a single key press from standard input (0)
+	Input. Key presses are read from standard input (0) in batches into a
+	small ring buffer, then decoded from there. Nothing ever spins: waiting
+	is done in ppoll() and frame pacing in clock_nanosleep().
+*/
+#define INBUF_SIZE 256				// Must be a power of 2
+#define ESC_WAIT_MS 25				// How long to wait for the rest of an escape sequence
+
+static unsigned char inbuf[INBUF_SIZE];
+static unsigned int inhead = 0,		// Next byte to write
+					intail = 0;		// Next byte to read
+static struct timespec frame_end;	// Deadline of the current frame
+static long frame_ns = 0;			// Frame period, 0 if frame_rate() wasn't called
+static char input_eof = 0;			// Standard input was closed
+
+#define INBUF_COUNT (inhead - intail)
+#define INBUF_PEEK(i) (inbuf[(intail + (i)) & (INBUF_SIZE - 1)])
+
+/*
+	Waits up to timeout ns (-1 = forever, 0 = don't wait) for input and reads
+	everything available that fits in the ring. Returns the number of bytes read.
+*/
+static int fill_input(long long timeout)
+{
+	struct pollfd pfd;
+	struct timespec ts, *tsp = NULL;
+	unsigned char tmp[INBUF_SIZE];
+	int n, i;
+
+	if (INBUF_COUNT == INBUF_SIZE) return 0; // Ring is full
+
+	if (timeout >= 0)
+	{
+		ts.tv_sec = timeout / 1000000000LL;
+		ts.tv_nsec = timeout % 1000000000LL;
+		tsp = &ts;
+	}
+	if (input_eof) // Nothing will ever arrive, just sit out the timeout
+	{
+		if (tsp != NULL) nanosleep(tsp, NULL);
+		return 0;
+	}
+
+	pfd.fd = 0; pfd.events = POLLIN;
+	if (ppoll(&pfd, 1, tsp, NULL) <= 0) return 0;
+	if ((n = read(0, tmp, INBUF_SIZE - INBUF_COUNT)) <= 0)
+	{
+		if (n == 0 || errno != EINTR) input_eof = 1;
+		return 0;
+	}
+
+	for (i = 0; i < n; ++i)
+		inbuf[(inhead++) & (INBUF_SIZE - 1)] = tmp[i];
+	return n;
+}
+
+/*
+	Decodes the next key from the ring. Arrow keys arrive as ESC [ A..D (or
+	ESC O A..D), other escape sequences are skipped. Returns 0 if the ring
+	holds no complete key.
+*/
+static int decode_key(event_t *ev)
+{
+	unsigned int i;
+
+	if (INBUF_COUNT == 0) return 0;
+	if (INBUF_PEEK(0) != '\033')
+	{
+		ev->key = INBUF_PEEK(0);
+		intail++;
+		return 1;
+	}
+
+	// A lone ESC could be the start of a sequence that hasn't arrived yet
+	if (INBUF_COUNT < 3) fill_input(ESC_WAIT_MS * 1000000LL);
+	if (INBUF_COUNT < 2 || (INBUF_PEEK(1) != '[' && INBUF_PEEK(1) != 'O'))
+	{
+		ev->key = KEY_ESC;
+		intail++;
+		return 1;
+	}
+
+	// Find the final byte of the sequence
+	for (i = 2; i < INBUF_COUNT; ++i)
+		if (INBUF_PEEK(i) >= 0x40 && INBUF_PEEK(i) <= 0x7e) break;
+	if (i == INBUF_COUNT) // Incomplete, drop it
+	{
+		intail = inhead;
+		return 0;
+	}
+
+	switch (i == 2 ? INBUF_PEEK(2) : 0)
+	{
+		case 'A': ev->key = KEY_UP; break;
+		case 'B': ev->key = KEY_DOWN; break;
+		case 'C': ev->key = KEY_RIGHT; break;
+		case 'D': ev->key = KEY_LEFT; break;
+		default:  ev->key = 0; break;	// Some other key, ignore it
+	}
+	intail += i + 1;
+	return ev->key != 0 || decode_key(ev);
+}
+
+// Nanoseconds from now until the given CLOCK_MONOTONIC time (can be negative)
+static long long ns_until(const struct timespec *t)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (t->tv_sec - now.tv_sec) * 1000000000LL + (t->tv_nsec - now.tv_nsec);
+}
+
+static void add_ns(struct timespec *t, long long ns)
+{
+	ns += t->tv_nsec;
+	t->tv_sec += ns / 1000000000LL;
+	t->tv_nsec = ns % 1000000000LL;
+}
+
+/*
+	Waits up to timeout_ms (-1 = forever) for a key. Returns 1 and fills ev
+	if one arrived, 0 on timeout.
+*/
+int wait_event(event_t *ev, long timeout_ms)
+{
+	struct timespec deadline;
+	long long left = -1;
+
+	if (!initialized || ev == NULL) return 0;
+	if (timeout_ms >= 0)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		add_ns(&deadline, timeout_ms * 1000000LL);
+	}
+
+	while (!decode_key(ev))
+	{
+		if (timeout_ms >= 0 && (left = ns_until(&deadline)) < 0) left = 0;
+		if (fill_input(left) == 0 && (left == 0 || input_eof)) return 0;
+	}
+	return 1;
+}
+
+/*
+	Starts a fixed-rate loop with a frame every period_ms. Frames are counted
+	from absolute times, so time spent drawing doesn't make the loop drift.
+*/
+void frame_rate(long period_ms)
+{
+	frame_ns = period_ms > 0 ? period_ms * 1000000L : 0;
+	clock_gettime(CLOCK_MONOTONIC, &frame_end);
+	add_ns(&frame_end, frame_ns);
+}
+
+// Moves on to the next frame. If we fell more than a frame behind, resync.
+static void next_frame(void)
+{
+	add_ns(&frame_end, frame_ns);
+	if (ns_until(&frame_end) < -frame_ns)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &frame_end);
+		add_ns(&frame_end, frame_ns);
+	}
+}
+
+/*
+	Returns the keys pressed during the current frame one at a time, waiting
+	for them as they come. Returns 0 once the frame is over.
+*/
+int frame_event(event_t *ev)
+{
+	long long left;
+
+	if (!initialized || ev == NULL || frame_ns == 0) return 0;
+	while (!decode_key(ev))
+	{
+		if ((left = ns_until(&frame_end)) <= 0)
+		{
+			next_frame();
+			return 0;
+		}
+		fill_input(left);
+	}
+	return 1;
+}
+
+// Sleeps until the end of the current frame
+void frame_wait()
+{
+	if (frame_ns == 0) return;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &frame_end, NULL) == EINTR);
+	next_frame();
+}
+
+/*
+	This function gets a single key press from standard input (0). Escape
+	sequences come back one byte at a time, use wait_event() to get them whole.
 */
 char getkey()
 {
 	if (initialized)
 	{
-		static fd_set rfds;
-		static struct timeval tv;
-
-      	// Watch stdin (fd 0) to see when it has input.
-        FD_ZERO(&rfds);
-        FD_SET(0, &rfds); // 0 is stdin
-	
-		tv.tv_sec = 0;
-		tv.tv_usec = 0;
-		// Read only if there is a key press ready
-		if (select(1, &rfds, NULL, NULL, &tv) > 0 && read(0, &key, 1) > 0) return key; 
+		if (INBUF_COUNT == 0) fill_input(0); // Read only if there is a key press ready
+		if (INBUF_COUNT > 0)
+		{
+			key = INBUF_PEEK(0);
+			intail++;
+			return key;
+		}
 	}
 	return 0;
 }
 
 void sleep_ms(long ms)
 { 
-	if (ms < 1000 && ms > 0) // tv_nsec has a max value of 999,999,999
+	if (ms > 0)
 	{
-		static struct timespec tspec;
+		struct timespec tspec;
 		
-		tspec.tv_sec = 0;
-		tspec.tv_nsec = ms * 1000000L;
+		tspec.tv_sec = ms / 1000;	// tv_nsec has a max value of 999,999,999
+		tspec.tv_nsec = (ms % 1000) * 1000000L;
 
-		nanosleep (&tspec, NULL);
+		while (nanosleep (&tspec, &tspec) == -1 && errno == EINTR);
 	}
- }
+}
  
 void clear_screen(void *img)
 {	// Check for initialization & valid arguments
 	if (initialized && img != NULL)
-	{
-		static int i;
-		for (i = 0; i < sizetommap; ++i)
-			*(((char *) img)+i) = 0;
-	}
+		memset(img, 0, sizetommap);
 }
 
 void draw_pixel(void *img, int x, int y, color_t color)
 {	// Check for initialization & valid arguments
 	if (initialized && img != NULL && x > -1 && x < xres && y> -1 && y < yres)
-		*((color_t *) img + x + y*xres) = color;
+	{
+		if (img == batch_img) record(CMD_RECT, x, y, x, y, to_native(color));
+		else ops.pixel(img, x, y, to_native(color));
+	}
 }
  
 void draw_line(void *img, int x1, int y1, int x2, int y2, color_t c)
 {
 	// Check for initialization & valid arguments
-	if (initialized && img!=NULL && x1 > -1 && x1 < xres && x2 > -1 && x2 <= xres &&
-					   				y1 > -1 && y1 < yres && y2 > -1 && y2 <= yres)
-	{
-		// Implementation of Bresenham's Line Plotting Algorithm
-		// Source: https://gist.github.com/bert/1085538
-		int dx =  abs (x2 - x1), 
-			sx = x1 < x2 ? 1 : -1,
-			dy = -abs (y2 - y1), 
-			sy = y1 < y2 ? 1 : -1,
-			err = dx + dy, 
-			e2; /* error value e_xy */
-
-		while(1)
-		{ 
-			*((color_t *) img + x1 + (y1*xres)) = c; // Draw the pixel
-			if (x1 == x2 && y1 == y2) break; // All pixels drawn
-			e2 = err << 1; //2 * err
-			if (e2 >= dy) { err += dy; x1 += sx; } /* e_xy+e_x > 0 */
-			if (e2 <= dx) { err += dx; y1 += sy; } /* e_xy+e_y < 0 */
-		}
+	if (initialized && img!=NULL && x1 > -1 && x1 < xres && x2 > -1 && x2 < xres &&
+					   				y1 > -1 && y1 < yres && y2 > -1 && y2 < yres)
+	{
+		if (img != batch_img) ops.line(img, x1, y1, x2, y2, to_native(c));
+		else if (x1 == x2 || y1 == y2) // Straight lines are just thin rectangles
+			record(CMD_RECT, x1 < x2 ? x1 : x2, y1 < y2 ? y1 : y2,
+							 x1 < x2 ? x2 : x1, y1 < y2 ? y2 : y1, to_native(c));
+		else record(CMD_LINE, x1, y1, x2, y2, to_native(c));
 	}
-} 
- 
- 
-void *new_offscreen_buffer()
+}
+
+/*
+	Fills [x1, x2] x [y1, y2] with a native pixel value, clipped to the screen.
+	Recorded instead if img is being batched.
+*/
+static void fill_native(char *img, int x1, int y1, int x2, int y2, unsigned int px)
 {
-	if (initialized)
+	// Clip to the screen
+	if (x1 < 0) x1 = 0;
+	if (y1 < 0) y1 = 0;
+	if (x2 >= xres) x2 = xres - 1;
+	if (y2 >= yres) y2 = yres - 1;
+	if (x1 > x2 || y1 > y2) return;
+
+	if (img == batch_img) record(CMD_RECT, x1, y1, x2, y2, px);
+	else
 	{
-		osbuff = mmap(NULL, sizetommap, PROT_READ|PROT_WRITE, 
-			MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
-		if(osbuff == MAP_FAILED) return NULL;
+		char *p = img + y1*stride + x1*bytespp;
+		for (; y1 <= y2; ++y1, p += stride)
+			ops.span(p, x2 - x1 + 1, px);
 	}
+}
+
+/*
+	Fills a w x h rectangle with its top left corner at (x, y). Parts outside
+	the screen are clipped.
+*/
+void fill_rect(void *img, int x, int y, int w, int h, color_t c)
+{
+	if (initialized && img != NULL && w > 0 && h > 0)
+		fill_native(img, x, y, x + w - 1, y + h - 1, to_native(c));
+}
+
+void convert_colors(void *dst, const color_t *src, int n)
+{
+	if (initialized && dst != NULL && src != NULL && n > 0)
+		ops.convert(dst, src, n);
+}
+
+
+/*
+	Off-screen buffers. They are mapped once & recycled through a pool, so a
+	program can keep several layers or take a scratch buffer per frame without
+	an mmap each time. Buffers of HUGE_PAGE bytes or more are rounded up &
+	aligned to it and marked for transparent huge pages, so a frame takes a
+	few TLB entries instead of thousands.
+*/
+static char *map_buffer(void)
+{
+	char *p, *a;
+	long align = sizetommap >= HUGE_PAGE ? HUGE_PAGE : sysconf(_SC_PAGESIZE);
+
+	bufsize = (sizetommap + align - 1) / align * align;
+	p = mmap(NULL, bufsize + (align == HUGE_PAGE ? align : 0), PROT_READ|PROT_WRITE,
+		MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) return NULL;
+	if (align != HUGE_PAGE) return p;
+
+	// Trim the mapping to an aligned bufsize bytes
+	a = (char *) (((uintptr_t) p + align - 1) & ~(uintptr_t) (align - 1));
+	if (a > p) munmap(p, a - p);
+	munmap(a + bufsize, p + align - a);
+#ifdef MADV_HUGEPAGE
+	madvise(a, bufsize, MADV_HUGEPAGE);
+#endif
+	return a;
+}
+
+// A free buffer from the pool, or a new one. *fresh is set if it was just mapped (zeroed).
+static void *take_buffer(int *fresh)
+{
+	int i;
+
+	*fresh = 0;
+	if (!initialized) return NULL;
+	for (i = 0; i < npool; ++i)
+		if (!pool[i].used)
+		{
+			pool[i].used = 1;
+			return pool[i].p;
+		}
+	if (npool == MAX_BUFFERS || (pool[npool].p = map_buffer()) == NULL) return NULL;
+	pool[npool].used = 1;
+	*fresh = 1;
+	return pool[npool++].p;
+}
+
+/*
+	Returns an off-screen buffer, recycled if one was released (with whatever
+	was left in it), NULL if there are MAX_BUFFERS in use already.
+*/
+void *acquire_buffer()
+{
+	int fresh;
+	return take_buffer(&fresh);
+}
+
+/*
+	Hands img back to the pool. Pending batched drawing on it is finished
+	first. img must not be used afterwards.
+*/
+void release_buffer(void *img)
+{
+	int i;
+
+	if (img == NULL) return;
+	if (img == batch_img) end_batch();
+	for (i = 0; i < npool; ++i)
+		if (pool[i].p == img) pool[i].used = 0;
+}
 
-	return osbuff;
+// A cleared buffer
+void *new_offscreen_buffer()
+{
+	int fresh;
+	void *img = take_buffer(&fresh);
+
+	if (img != NULL && !fresh) memset(img, 0, sizetommap);
+	return img;
 }
 
 void blit(void *src)
 {
 	if (initialized && src != NULL)
 	{
-		static int i;
-		for (i = 0; i < sizetommap; ++i)
-			*(((char *) fbuff)+i) = *(((char*)src)+i);
+		memcpy(fbuff, src, sizetommap);
+		if (rec_on) capture(src, 0, 0, xres, yres);
+	}
+}
+
+/*
+	Copies only the w x h rectangle at (x, y) of src to the screen, clipped.
+	For programs that know which parts of the frame changed.
+*/
+void blit_rect(void *src, int x, int y, int w, int h)
+{
+	int x2 = x + w - 1, y2 = y + h - 1, y1;
+	char *s, *d;
+
+	if (!initialized || src == NULL || w <= 0 || h <= 0) return;
+	if (x < 0) x = 0;
+	if (y < 0) y = 0;
+	if (x2 >= xres) x2 = xres - 1;
+	if (y2 >= yres) y2 = yres - 1;
+	if (x > x2 || y > y2) return;
+
+	s = (char *) src + y*stride + x*bytespp;
+	d = (char *) fbuff + y*stride + x*bytespp;
+	for (y1 = y; y <= y2; ++y, s += stride, d += stride)
+		memcpy(d, s, (x2 - x + 1) * bytespp);
+	if (rec_on) capture(src, x, y1, x2 - x + 1, y2 - y1 + 1);
+}
+
+
+/*
+	Recording. Between record_start() & record_stop() every blit() &
+	blit_rect() also goes to a file, for play.c to show again. The render loop
+	only copies the blitted rectangle into a free slot of a small ring & moves
+	on; the encoder thread converts it to RGB565, compares it with the last
+	frame written one 64x64 tile at a time & run-length encodes the tiles that
+	changed. When the ring is full the blit isn't queued & the next one that is
+	takes the whole screen, so the render loop never waits & the recording
+	only loses the frames in between.
+
+	File, in native byte order:
+		header  "FBR1", u16 width, u16 height, u16 tile size, u16 0
+		frame   u32 ms since record_start(), u32 bytes after this field,
+				u16 tiles, then for each tile its u16 index (row major) & its
+				pixels row by row, in runs:
+					u16 n < 0x8000, u16 pixel	n copies of pixel
+					u16 0x8000 | n, n pixels	n pixels as they are
+*/
+#define REC_TILES_X ((xres + TILE_SIZE - 1) / TILE_SIZE)
+#define REC_TILES_Y ((yres + TILE_SIZE - 1) / TILE_SIZE)
+#define REC_TILE_MAX (4 + 2 * TILE_SIZE * TILE_SIZE) // Bytes a tile can take, at worst
+
+// Queues the w x h rect at (x, y) of src (already clipped to the screen)
+static void capture(const char *src, int x, int y, int w, int h)
+{
+	struct rec_slot *slot;
+	int full, r;
+
+	pthread_mutex_lock(&rec_lock);
+	full = rec_head - rec_tail == REC_SLOTS;
+	pthread_mutex_unlock(&rec_lock);
+	if (full)
+	{
+		rec_resync = 1;
+		return;
+	}
+	if (rec_resync) // The screen has everything since the last queued blit
+	{
+		src = fbuff;
+		x = y = 0; w = xres; h = yres;
+		rec_resync = 0;
+	}
+
+	slot = &rec_ring[rec_head % REC_SLOTS];
+	if (x == 0 && w == xres)
+		memcpy(slot->pixels + y*stride, src + y*stride, (long) h * stride);
+	else
+		for (r = y; r < y + h; ++r)
+			memcpy(slot->pixels + r*stride + x*bytespp, src + r*stride + x*bytespp, w * bytespp);
+	slot->x = x; slot->y = y; slot->w = w; slot->h = h;
+	slot->ms = (unsigned int) (-ns_until(&rec_start) / 1000000);
+
+	pthread_mutex_lock(&rec_lock);
+	rec_head++;
+	pthread_cond_signal(&rec_wake);
+	pthread_mutex_unlock(&rec_lock);
+}
+
+static unsigned char *put16(unsigned char *p, unsigned int v)
+{
+	uint16_t u = (uint16_t) v;
+	memcpy(p, &u, 2);
+	return p + 2;
+}
+
+// Run-length encodes n pixels. Runs of 3 or more are worth breaking a literal for.
+static unsigned char *encode_runs(unsigned char *out, const color_t *p, int n)
+{
+	int i = 0, lit = 0, run;
+
+	while (i < n)
+	{
+		for (run = 1; i + run < n && p[i + run] == p[i]; ++run);
+		if (run < 3)
+		{
+			i += run;
+			continue;
+		}
+		if (lit < i)
+		{
+			out = put16(out, 0x8000 | (i - lit));
+			memcpy(out, p + lit, (i - lit) * 2);
+			out += (i - lit) * 2;
+		}
+		out = put16(put16(out, run), p[i]);
+		lit = i += run;
+	}
+	if (lit < n)
+	{
+		out = put16(out, 0x8000 | (n - lit));
+		memcpy(out, p + lit, (n - lit) * 2);
+		out += (n - lit) * 2;
 	}
-}
\ No newline at end of file
+	return out;
+}
+
+/*
+	Appends tile (tx, ty) to out if it changed since the last frame written,
+	& remembers it as written. Returns the new end of out.
+*/
+static unsigned char *encode_tile(unsigned char *out, int tx, int ty)
+{
+	int x = tx * TILE_SIZE, y = ty * TILE_SIZE, r, changed = rec_first,
+		w = xres - x < TILE_SIZE ? xres - x : TILE_SIZE,
+		h = yres - y < TILE_SIZE ? yres - y : TILE_SIZE;
+	color_t *cur = rec_cur + y*xres + x, *prev = rec_prev + y*xres + x;
+
+	for (r = 0; r < h && !changed; ++r)
+		changed = memcmp(cur + r*xres, prev + r*xres, w * 2) != 0;
+	if (!changed) return out;
+
+	for (r = 0; r < h; ++r)
+	{
+		memcpy(rec_tile + r*w, cur + r*xres, w * 2);
+		memcpy(prev + r*xres, cur + r*xres, w * 2);
+	}
+	return encode_runs(put16(out, ty*REC_TILES_X + tx), rec_tile, w * h);
+}
+
+// Encodes one slot & writes it out, unless no tile changed
+static void encode_frame(const struct rec_slot *slot)
+{
+	unsigned char *out = rec_out + 10;
+	int r, tx, ty, n = 0;
+	uint32_t head[2];
+
+	for (r = slot->y; r < slot->y + slot->h; ++r)
+		ops.unconvert(rec_cur + r*xres + slot->x,
+			slot->pixels + r*stride + slot->x*bytespp, slot->w);
+
+	for (ty = slot->y / TILE_SIZE; ty <= (slot->y + slot->h - 1) / TILE_SIZE; ++ty)
+		for (tx = slot->x / TILE_SIZE; tx <= (slot->x + slot->w - 1) / TILE_SIZE; ++tx)
+		{
+			unsigned char *end = encode_tile(out, tx, ty);
+			if (end != out) n++;
+			out = end;
+		}
+	rec_first = 0;
+	if (n == 0) return;
+
+	head[0] = slot->ms;
+	head[1] = (uint32_t) (out - rec_out - 8);
+	memcpy(rec_out, head, 8);
+	put16(rec_out + 8, n);
+	if (fwrite(rec_out, 1, out - rec_out, rec_file) != (size_t) (out - rec_out))
+		rec_error = 1;
+	rec_frames++;
+}
+
+static void *rec_worker(void *arg)
+{
+	(void) arg;
+	pthread_mutex_lock(&rec_lock);
+	while (1)
+	{
+		while (rec_head == rec_tail && !rec_quit)
+			pthread_cond_wait(&rec_wake, &rec_lock);
+		if (rec_head == rec_tail) break;
+		pthread_mutex_unlock(&rec_lock);
+
+		encode_frame(&rec_ring[rec_tail % REC_SLOTS]);
+
+		pthread_mutex_lock(&rec_lock);
+		rec_tail++;
+	}
+	pthread_mutex_unlock(&rec_lock);
+	return NULL;
+}
+
+// Frees everything record_start() allocated
+static void free_recorder(void)
+{
+	int i;
+	for (i = 0; i < REC_SLOTS; ++i)
+	{
+		free(rec_ring[i].pixels);
+		rec_ring[i].pixels = NULL;
+	}
+	free(rec_cur); free(rec_prev); free(rec_tile); free(rec_out);
+	rec_cur = rec_prev = rec_tile = NULL;
+	rec_out = NULL;
+}
+
+/*
+	Starts recording to file (overwritten). The first frame is the whole
+	screen as it is now. Returns 0, or -1 if it can't record.
+*/
+int record_start(const char *file)
+{
+	uint16_t head[6] = {0, 0, 0, 0, 0, 0};
+	int i, ok;
+
+	if (!initialized || rec_on || file == NULL) return -1;
+	for (i = 0, ok = 1; i < REC_SLOTS; ++i)
+		ok &= (rec_ring[i].pixels = malloc(sizetommap)) != NULL;
+	rec_cur = malloc((long) xres * yres * sizeof(color_t));
+	rec_prev = malloc((long) xres * yres * sizeof(color_t));
+	rec_tile = malloc(TILE_SIZE * TILE_SIZE * sizeof(color_t));
+	rec_out = malloc(10 + (long) REC_TILES_X * REC_TILES_Y * REC_TILE_MAX);
+	if (!ok || !rec_cur || !rec_prev || !rec_tile || !rec_out ||
+		(rec_file = fopen(file, "wb")) == NULL)
+	{
+		free_recorder();
+		return -1;
+	}
+
+	memcpy(head, "FBR1", 4);
+	head[2] = xres; head[3] = yres; head[4] = TILE_SIZE;
+	fwrite(head, 2, 6, rec_file);
+
+	rec_head = rec_tail = 0;
+	rec_quit = rec_error = 0;
+	rec_resync = rec_first = 1;
+	rec_frames = 0;
+	clock_gettime(CLOCK_MONOTONIC, &rec_start);
+	if (pthread_create(&rec_thread, NULL, rec_worker, NULL) != 0)
+	{
+		fclose(rec_file);
+		free_recorder();
+		return -1;
+	}
+	rec_on = 1;
+	capture(fbuff, 0, 0, xres, yres);
+	return 0;
+}
+
+/*
+	Waits for the queued frames to be written & closes the file. Returns the
+	number of frames in it, or -1 if writing failed or nothing was recording.
+*/
+long record_stop()
+{
+	if (!rec_on) return -1;
+	rec_on = 0;
+
+	pthread_mutex_lock(&rec_lock);
+	rec_quit = 1;
+	pthread_cond_signal(&rec_wake);
+	pthread_mutex_unlock(&rec_lock);
+	pthread_join(rec_thread, NULL);
+
+	if (ferror(rec_file)) rec_error = 1;
+	if (fclose(rec_file) != 0) rec_error = 1;
+	free_recorder();
+	return rec_error ? -1 : rec_frames;
+}
+
+
+/*
+	Sprites. Rows are clipped to the screen, then either converted straight
+	into the buffer (opaque sprites) or blended in RGB565 and converted back.
+*/
+// Flushes pending batched commands on img so immediate drawing lands on top
+static void flush_batch(void *img)
+{
+	if (img == batch_img)
+	{
+		end_batch();
+		begin_batch(img);
+	}
+}
+
+/*
+	d = d + (s - d) * a / 256 for each channel of n RGB565 pixels. a == NULL
+	means fully opaque. Source pixels equal to key (if key > -1) are skipped.
+*/
+static void blend_row(color_t *d, const color_t *s, const unsigned char *a,
+					  int n, int key)
+{
+	int i = 0;
+#ifdef __SSE2__
+	const __m128i m5 = _mm_set1_epi16(0x1f), m6 = _mm_set1_epi16(0x3f),
+				  zero = _mm_setzero_si128(), opaque = _mm_set1_epi16(255),
+				  k = _mm_set1_epi16((short) key),
+				  usekey = _mm_set1_epi16(key > -1 ? -1 : 0);
+	for (; i + 8 <= n; i += 8)
+	{
+		__m128i sv = _mm_loadu_si128((const __m128i *) (s + i)),
+				dv = _mm_loadu_si128((const __m128i *) (d + i)),
+				av = a ? _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (a + i)), zero)
+					   : opaque, sc, dc, r, g, b;
+
+		// 0..255 -> 0..256 so full alpha copies exactly, then drop keyed pixels
+		av = _mm_add_epi16(av, _mm_srli_epi16(av, 7));
+		av = _mm_andnot_si128(_mm_and_si128(_mm_cmpeq_epi16(sv, k), usekey), av);
+
+		sc = _mm_srli_epi16(sv, 11); dc = _mm_srli_epi16(dv, 11);
+		r = _mm_add_epi16(dc, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(sc, dc), av), 8));
+		sc = _mm_and_si128(_mm_srli_epi16(sv, 5), m6); dc = _mm_and_si128(_mm_srli_epi16(dv, 5), m6);
+		g = _mm_add_epi16(dc, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(sc, dc), av), 8));
+		sc = _mm_and_si128(sv, m5); dc = _mm_and_si128(dv, m5);
+		b = _mm_add_epi16(dc, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(sc, dc), av), 8));
+
+		_mm_storeu_si128((__m128i *) (d + i),
+			_mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 11), _mm_slli_epi16(g, 5)), b));
+	}
+#endif
+	for (; i < n; ++i)
+	{
+		int al = a ? a[i] : 255, sr, sg, sb, dr, dg, db;
+		if (s[i] == key) continue;
+		al += al >> 7;
+		sr = s[i] >> 11; sg = (s[i] >> 5) & 0x3f; sb = s[i] & 0x1f;
+		dr = d[i] >> 11; dg = (d[i] >> 5) & 0x3f; db = d[i] & 0x1f;
+		dr += ((sr - dr) * al) >> 8;
+		dg += ((sg - dg) * al) >> 8;
+		db += ((sb - db) * al) >> 8;
+		d[i] = dr << 11 | dg << 5 | db;
+	}
+}
+
+/*
+	Puts n RGB565 pixels on a buffer row, blended by alpha (NULL if opaque)
+	& leaving out key (-1 for none). rowbuf must be allocated.
+*/
+static void put_row(char *row, const color_t *src, const unsigned char *alpha, int n, int key)
+{
+	if (alpha == NULL && key < 0)				// Opaque, just convert
+		ops.convert(row, src, n);
+	else if (ops.unconvert == unconvert_copy)	// Buffer is RGB565 already
+		blend_row((color_t *) row, src, alpha, n, key);
+	else
+	{
+		ops.unconvert(rowbuf, row, n);
+		blend_row(rowbuf, src, alpha, n, key);
+		ops.convert(row, rowbuf, n);
+	}
+}
+
+/*
+	Draws sprite with its top left corner at (x, y), clipped to the screen.
+	Honors the sprite's colorkey and per-pixel alpha.
+*/
+void blit_sprite(void *dst, const sprite_t *sprite, int x, int y)
+{
+	int sx = 0, sy = 0, w, h, r;
+	const unsigned char *alpha;
+
+	if (!initialized || dst == NULL || sprite == NULL || sprite->pixels == NULL) return;
+	if (rowbuf == NULL && (rowbuf = malloc(xres * sizeof(color_t))) == NULL) return;
+
+	// Clip against the screen edges
+	if (x < 0) { sx = -x; x = 0; }
+	if (y < 0) { sy = -y; y = 0; }
+	w = (sprite->w - sx < xres - x) ? sprite->w - sx : xres - x;
+	h = (sprite->h - sy < yres - y) ? sprite->h - sy : yres - y;
+	if (w <= 0 || h <= 0) return;
+
+	flush_batch(dst);
+	for (r = 0; r < h; ++r)
+	{
+		alpha = sprite->alpha ? sprite->alpha + (sy + r)*sprite->w + sx : NULL;
+		put_row((char *) dst + (y + r)*stride + x*bytespp,
+			sprite->pixels + (sy + r)*sprite->w + sx, alpha, w, sprite->colorkey);
+	}
+}
+
+
+/*
+	Scaled & rotated sprites. Each destination pixel is mapped back to the
+	sprite in 16.16 fixed point & sampled there: the nearest pixel, or a
+	bilinear blend of the 2x2 around it with weights in 1/256ths (8 pixels at
+	a time with SSE2). The destination is walked in TILE_SIZE squares, so a
+	rotated sprite is read from a small area at a time, & each piece of a row
+	is blended like blit_sprite() does. The colorkey is checked after
+	sampling, so it's only exact with SAMPLE_NEAREST.
+*/
+#define FIX_ONE 65536
+
+// Samples of one tile row, 2x2 blocks for bilinear filtering
+struct samples
+{
+	color_t out[TILE_SIZE], a[TILE_SIZE], b[TILE_SIZE], c[TILE_SIZE], d[TILE_SIZE];
+	unsigned short fx[TILE_SIZE], fy[TILE_SIZE];
+	unsigned char alpha[TILE_SIZE];
+};
+
+#define LERP(p, q, w) ((p) + ((((q) - (p)) * (w)) >> 8))
+
+// s->out = blend of a b over c d by fx & fy, per channel
+static void lerp_row(struct samples *s, int n)
+{
+	int i = 0;
+#ifdef __SSE2__
+	const __m128i m5 = _mm_set1_epi16(0x1f), m6 = _mm_set1_epi16(0x3f);
+#define LERP8(p, q, w) _mm_add_epi16(p, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(q, p), w), 8))
+#define BLEND8(ch) LERP8(LERP8(ch(av), ch(bv), wx), LERP8(ch(cv), ch(dv), wx), wy)
+#define RED(v)   _mm_srli_epi16(v, 11)
+#define GREEN(v) _mm_and_si128(_mm_srli_epi16(v, 5), m6)
+#define BLUE(v)  _mm_and_si128(v, m5)
+	for (; i + 8 <= n; i += 8)
+	{
+		__m128i av = _mm_loadu_si128((const __m128i *) (s->a + i)),
+				bv = _mm_loadu_si128((const __m128i *) (s->b + i)),
+				cv = _mm_loadu_si128((const __m128i *) (s->c + i)),
+				dv = _mm_loadu_si128((const __m128i *) (s->d + i)),
+				wx = _mm_loadu_si128((const __m128i *) (s->fx + i)),
+				wy = _mm_loadu_si128((const __m128i *) (s->fy + i));
+
+		_mm_storeu_si128((__m128i *) (s->out + i),
+			_mm_or_si128(_mm_or_si128(_mm_slli_epi16(BLEND8(RED), 11),
+				_mm_slli_epi16(BLEND8(GREEN), 5)), BLEND8(BLUE)));
+	}
+#undef LERP8
+#undef BLEND8
+#undef RED
+#undef GREEN
+#undef BLUE
+#endif
+	for (; i < n; ++i)
+	{
+		int a = s->a[i], b = s->b[i], c = s->c[i], d = s->d[i], wx = s->fx[i], wy = s->fy[i];
+		int r = LERP(LERP(a >> 11, b >> 11, wx), LERP(c >> 11, d >> 11, wx), wy),
+			g = LERP(LERP((a >> 5) & 0x3f, (b >> 5) & 0x3f, wx),
+					 LERP((c >> 5) & 0x3f, (d >> 5) & 0x3f, wx), wy),
+			bl = LERP(LERP(a & 0x1f, b & 0x1f, wx), LERP(c & 0x1f, d & 0x1f, wx), wy);
+		s->out[i] = r << 11 | g << 5 | bl;
+	}
+}
+
+// Fixed point source position of destination pixel i of n, centers lined up
+static int fix_center(int i, int n, int size)
+{
+	return (int) (((2LL*i + 1) * size * FIX_ONE) / (2LL*n));
+}
+
+// Fills colmap for dw destination columns out of sw
+static int map_columns(int sw, int dw, int filter)
+{
+	int i, u;
+
+	if (colmap.sw == sw && colmap.dw == dw && colmap.filter == filter) return 1;
+	free(colmap.x0); free(colmap.fx);
+	colmap.x0 = malloc(dw * sizeof(int));
+	colmap.fx = malloc(dw * sizeof(unsigned short));
+	if (colmap.x0 == NULL || colmap.fx == NULL)
+	{
+		free(colmap.x0); free(colmap.fx);
+		colmap.x0 = NULL; colmap.fx = NULL; colmap.filter = -1;
+		return 0;
+	}
+	for (i = 0; i < dw; ++i)
+	{
+		u = fix_center(i, dw, sw);
+		if (filter == SAMPLE_BILINEAR) u = u < FIX_ONE/2 ? 0 : u - FIX_ONE/2;
+		colmap.x0[i] = u >> 16;
+		colmap.fx[i] = filter == SAMPLE_BILINEAR ? (u >> 8) & 0xff : 0;
+	}
+	colmap.sw = sw; colmap.dw = dw; colmap.filter = filter;
+	return 1;
+}
+
+/*
+	Draws sprite stretched to w x h with its top left corner at (x, y),
+	clipped to the screen. filter is SAMPLE_NEAREST or SAMPLE_BILINEAR.
+*/
+void blit_scaled(void *dst, const sprite_t *sprite, int x, int y, int w, int h, int filter)
+{
+	struct samples s;
+	int x1 = x + w, y1 = y + h, tx, ty, r, i, n, v, sy0, sy1, sw;
+	const color_t *row0, *row1;
+
+	if (!initialized || dst == NULL || sprite == NULL || sprite->pixels == NULL ||
+		w <= 0 || h <= 0 || sprite->w <= 0 || sprite->h <= 0) return;
+	if (rowbuf == NULL && (rowbuf = malloc(xres * sizeof(color_t))) == NULL) return;
+	if (!map_columns(sprite->w, w, filter)) return;
+	sw = sprite->w;
+
+	flush_batch(dst);
+	for (ty = y < 0 ? 0 : y; ty < y1 && ty < yres; ty += TILE_SIZE)
+		for (tx = x < 0 ? 0 : x; tx < x1 && tx < xres; tx += TILE_SIZE)
+		{
+			n = x1 - tx < TILE_SIZE ? x1 - tx : TILE_SIZE;
+			if (n > xres - tx) n = xres - tx;
+			for (r = ty; r < ty + TILE_SIZE && r < y1 && r < yres; ++r)
+			{
+				const int *x0 = colmap.x0 + (tx - x);
+
+				// Source row(s) for this destination row
+				v = fix_center(r - y, h, sprite->h);
+				if (filter == SAMPLE_BILINEAR) v = v < FIX_ONE/2 ? 0 : v - FIX_ONE/2;
+				sy0 = v >> 16;
+				sy1 = sy0 + (sy0 < sprite->h - 1);
+				row0 = sprite->pixels + sy0*sw;
+				row1 = sprite->pixels + sy1*sw;
+
+				if (filter == SAMPLE_BILINEAR)
+				{
+					for (i = 0; i < n; ++i)
+					{
+						int c = x0[i], c1 = c + (c < sw - 1);
+						s.a[i] = row0[c]; s.b[i] = row0[c1];
+						s.c[i] = row1[c]; s.d[i] = row1[c1];
+						s.fy[i] = (v >> 8) & 0xff;
+					}
+					memcpy(s.fx, colmap.fx + (tx - x), n * sizeof(unsigned short));
+					lerp_row(&s, n);
+				}
+				else
+					for (i = 0; i < n; ++i) s.out[i] = row0[x0[i]];
+
+				// Alpha of the nearest pixel
+				if (sprite->alpha)
+				{
+					const unsigned char *arow = sprite->alpha +
+						(filter == SAMPLE_BILINEAR && ((v >> 8) & 0xff) >= 128 ? sy1 : sy0)*sw;
+					for (i = 0; i < n; ++i)
+						s.alpha[i] = arow[x0[i] + (filter == SAMPLE_BILINEAR &&
+							s.fx[i] >= 128 && x0[i] < sw - 1)];
+				}
+				put_row((char *) dst + r*stride + tx*bytespp, s.out,
+					sprite->alpha ? s.alpha : NULL, n, sprite->colorkey);
+			}
+		}
+}
+
+/*
+	Draws sprite scaled by scale & turned angle radians clockwise about its
+	center, which lands on (cx, cy). Clipped to the screen. filter is
+	SAMPLE_NEAREST or SAMPLE_BILINEAR.
+*/
+void blit_transformed(void *dst, const sprite_t *sprite, int cx, int cy,
+	double scale, double angle, int filter)
+{
+	struct samples s;
+	double co, si, ex, ey;
+	long long u, v, du, dv; // 16.16, wide so big sprites & steps can't wrap
+	int x0, y0, x1, y1, tx, ty, r, i, n, sw, sh, all_in;
+
+	// Below 1/INT_MAX of a pixel per step the sprite is smaller than a pixel
+	if (!initialized || dst == NULL || sprite == NULL || sprite->pixels == NULL ||
+		scale <= 0 || (double) FIX_ONE / scale > INT_MAX ||
+		sprite->w <= 0 || sprite->h <= 0) return;
+	if (rowbuf == NULL && (rowbuf = malloc(xres * sizeof(color_t))) == NULL) return;
+	sw = sprite->w; sh = sprite->h;
+	co = cos(angle); si = sin(angle);
+
+	// Bounding box of the turned sprite, clipped
+	ex = (fabs(co) * sw + fabs(si) * sh) * scale / 2 + 1;
+	ey = (fabs(si) * sw + fabs(co) * sh) * scale / 2 + 1;
+	x0 = cx - ex < 0 ? 0 : (int) (cx - ex);
+	y0 = cy - ey < 0 ? 0 : (int) (cy - ey);
+	x1 = cx + ex > xres ? xres : (int) (cx + ex);
+	y1 = cy + ey > yres ? yres : (int) (cy + ey);
+
+	// Source steps per destination column
+	du = llround(co / scale * FIX_ONE);
+	dv = llround(-si / scale * FIX_ONE);
+
+	flush_batch(dst);
+	for (ty = y0; ty < y1; ty += TILE_SIZE)
+		for (tx = x0; tx < x1; tx += TILE_SIZE)
+		{
+			n = x1 - tx < TILE_SIZE ? x1 - tx : TILE_SIZE;
+			for (r = ty; r < ty + TILE_SIZE && r < y1; ++r)
+			{
+				// Source position of this row piece's first pixel center
+				double dx = tx + 0.5 - cx, dy = r + 0.5 - cy;
+				u = llround(((co * dx + si * dy) / scale + sw / 2.0) * FIX_ONE);
+				v = llround(((-si * dx + co * dy) / scale + sh / 2.0) * FIX_ONE);
+
+				for (i = 0, all_in = 1; i < n; ++i, u += du, v += dv)
+				{
+					int in = u >= 0 && v >= 0 && u < (long long) sw * FIX_ONE &&
+							 v < (long long) sh * FIX_ONE,
+						px = in ? (int) (u >> 16) : 0, py = in ? (int) (v >> 16) : 0;
+
+					all_in &= in;
+					s.alpha[i] = !in ? 0 : sprite->alpha ? sprite->alpha[py*sw + px] : 255;
+					if (filter == SAMPLE_BILINEAR)
+					{
+						long long bu = u - FIX_ONE/2, bv = v - FIX_ONE/2;
+						int c0 = bu < 0 || !in ? 0 : (int) (bu >> 16),
+							r0 = bv < 0 || !in ? 0 : (int) (bv >> 16),
+							c1 = c0 + (c0 < sw - 1 && bu >= 0 && in),
+							r1 = r0 + (r0 < sh - 1 && bv >= 0 && in);
+						s.a[i] = sprite->pixels[r0*sw + c0]; s.b[i] = sprite->pixels[r0*sw + c1];
+						s.c[i] = sprite->pixels[r1*sw + c0]; s.d[i] = sprite->pixels[r1*sw + c1];
+						s.fx[i] = (bu >> 8) & 0xff;
+						s.fy[i] = (bv >> 8) & 0xff;
+					}
+					else
+						s.out[i] = sprite->pixels[py*sw + px];
+				}
+				if (filter == SAMPLE_BILINEAR) lerp_row(&s, n);
+				// Opaque sprites take the plain convert when the row is all inside
+				put_row((char *) dst + r*stride + tx*bytespp, s.out,
+					sprite->alpha == NULL && all_in ? NULL : s.alpha, n, sprite->colorkey);
+			}
+		}
+}
+
+
+/*
+	Layers. composite() builds a frame from full screen buffers stacked
+	bottom to top in a single pass: each pixel of dst comes from the topmost
+	layer that isn't the key color there. Keys are compared in the native
+	format, 8 (16 bpp) or 4 (32 bpp) pixels at a time with SSE2.
+*/
+static void composite_row(char *d, char *const *rows, int n, int w, unsigned int key)
+{
+	int i = 0, l;
+#ifdef __SSE2__
+	if (bytespp == 2)
+	{
+		const __m128i k = _mm_set1_epi16((short) key);
+		for (; i + 8 <= w; i += 8)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i *) (rows[0] + i*2)), s, m;
+			for (l = 1; l < n; ++l)
+			{
+				s = _mm_loadu_si128((const __m128i *) (rows[l] + i*2));
+				m = _mm_cmpeq_epi16(s, k); // Keyed, keep what's below
+				v = _mm_or_si128(_mm_and_si128(m, v), _mm_andnot_si128(m, s));
+			}
+			_mm_storeu_si128((__m128i *) (d + i*2), v);
+		}
+	}
+	else if (bytespp == 4)
+	{
+		const __m128i k = _mm_set1_epi32((int) key);
+		for (; i + 4 <= w; i += 4)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i *) (rows[0] + i*4)), s, m;
+			for (l = 1; l < n; ++l)
+			{
+				s = _mm_loadu_si128((const __m128i *) (rows[l] + i*4));
+				m = _mm_cmpeq_epi32(s, k);
+				v = _mm_or_si128(_mm_and_si128(m, v), _mm_andnot_si128(m, s));
+			}
+			_mm_storeu_si128((__m128i *) (d + i*4), v);
+		}
+	}
+#endif
+	for (; i < w; ++i)
+	{
+		for (l = n - 1; l > 0; --l)
+		{
+			const unsigned char *p = (const unsigned char *) rows[l] + i*bytespp;
+			unsigned int px = bytespp == 2 ? *(const uint16_t *) p :
+							  bytespp == 3 ? (unsigned int) (p[0] | p[1] << 8 | p[2] << 16) :
+							  *(const uint32_t *) p;
+			if (px != key) break;
+		}
+		memcpy(d + i*bytespp, rows[l] + i*bytespp, bytespp);
+	}
+}
+
+/*
+	dst = layers[0] with layers[1..n-1] drawn over it in order, leaving out
+	their pixels of color key. dst may be one of the layers.
+*/
+void composite(void *dst, void *const *layers, int n, color_t key)
+{
+	char *rows[MAX_BUFFERS + 1];
+	unsigned int px;
+	int i, y;
+
+	if (!initialized || dst == NULL || layers == NULL || n < 1 || n > MAX_BUFFERS + 1) return;
+	for (i = 0; i < n; ++i)
+	{
+		if (layers[i] == NULL) return;
+		flush_batch(layers[i]);
+		rows[i] = layers[i];
+	}
+	flush_batch(dst);
+
+	// The key as the layers store it (the low 24 bits at 24 bpp)
+	px = to_native(key);
+	if (bytespp == 3) px &= 0xffffff;
+	else if (bytespp == 2) px &= 0xffff;
+
+	for (y = 0; y < yres; ++y)
+	{
+		composite_row((char *) dst + y*stride, rows, n, xres, px);
+		for (i = 0; i < n; ++i) rows[i] += stride;
+	}
+}
+
+/*
+	Text. Glyphs come from the classic 5x7 LCD font, one byte per column with
+	the top row in bit 0, drawn in 6x8 cells. The first time a character is
+	used its bitmap is turned into horizontal runs and cached, so drawing a
+	glyph is a handful of span fills.
+*/
+#define FONT_FIRST 32
+#define FONT_CHARS 95
+#define GLYPH_W 5
+#define GLYPH_H 7
+
+static const unsigned char font5x7[FONT_CHARS][GLYPH_W] =
+{
+	{0x00, 0x00, 0x00, 0x00, 0x00},	//  
+	{0x00, 0x00, 0x5F, 0x00, 0x00},	// !
+	{0x00, 0x07, 0x00, 0x07, 0x00},	// "
+	{0x14, 0x7F, 0x14, 0x7F, 0x14},	// #
+	{0x24, 0x2A, 0x7F, 0x2A, 0x12},	// $
+	{0x23, 0x13, 0x08, 0x64, 0x62},	// %
+	{0x36, 0x49, 0x55, 0x22, 0x50},	// &
+	{0x00, 0x05, 0x03, 0x00, 0x00},	// '
+	{0x00, 0x1C, 0x22, 0x41, 0x00},	// (
+	{0x00, 0x41, 0x22, 0x1C, 0x00},	// )
+	{0x14, 0x08, 0x3E, 0x08, 0x14},	// *
+	{0x08, 0x08, 0x3E, 0x08, 0x08},	// +
+	{0x00, 0x50, 0x30, 0x00, 0x00},	// ,
+	{0x08, 0x08, 0x08, 0x08, 0x08},	// -
+	{0x00, 0x60, 0x60, 0x00, 0x00},	// .
+	{0x20, 0x10, 0x08, 0x04, 0x02},	// /
+	{0x3E, 0x51, 0x49, 0x45, 0x3E},	// 0
+	{0x00, 0x42, 0x7F, 0x40, 0x00},	// 1
+	{0x42, 0x61, 0x51, 0x49, 0x46},	// 2
+	{0x21, 0x41, 0x45, 0x4B, 0x31},	// 3
+	{0x18, 0x14, 0x12, 0x7F, 0x10},	// 4
+	{0x27, 0x45, 0x45, 0x45, 0x39},	// 5
+	{0x3C, 0x4A, 0x49, 0x49, 0x30},	// 6
+	{0x01, 0x71, 0x09, 0x05, 0x03},	// 7
+	{0x36, 0x49, 0x49, 0x49, 0x36},	// 8
+	{0x06, 0x49, 0x49, 0x29, 0x1E},	// 9
+	{0x00, 0x36, 0x36, 0x00, 0x00},	// :
+	{0x00, 0x56, 0x36, 0x00, 0x00},	// ;
+	{0x08, 0x14, 0x22, 0x41, 0x00},	// <
+	{0x14, 0x14, 0x14, 0x14, 0x14},	// =
+	{0x00, 0x41, 0x22, 0x14, 0x08},	// >
+	{0x02, 0x01, 0x51, 0x09, 0x06},	// ?
+	{0x32, 0x49, 0x79, 0x41, 0x3E},	// @
+	{0x7E, 0x11, 0x11, 0x11, 0x7E},	// A
+	{0x7F, 0x49, 0x49, 0x49, 0x36},	// B
+	{0x3E, 0x41, 0x41, 0x41, 0x22},	// C
+	{0x7F, 0x41, 0x41, 0x22, 0x1C},	// D
+	{0x7F, 0x49, 0x49, 0x49, 0x41},	// E
+	{0x7F, 0x09, 0x09, 0x01, 0x01},	// F
+	{0x3E, 0x41, 0x41, 0x51, 0x32},	// G
+	{0x7F, 0x08, 0x08, 0x08, 0x7F},	// H
+	{0x00, 0x41, 0x7F, 0x41, 0x00},	// I
+	{0x20, 0x40, 0x41, 0x3F, 0x01},	// J
+	{0x7F, 0x08, 0x14, 0x22, 0x41},	// K
+	{0x7F, 0x40, 0x40, 0x40, 0x40},	// L
+	{0x7F, 0x02, 0x04, 0x02, 0x7F},	// M
+	{0x7F, 0x04, 0x08, 0x10, 0x7F},	// N
+	{0x3E, 0x41, 0x41, 0x41, 0x3E},	// O
+	{0x7F, 0x09, 0x09, 0x09, 0x06},	// P
+	{0x3E, 0x41, 0x51, 0x21, 0x5E},	// Q
+	{0x7F, 0x09, 0x19, 0x29, 0x46},	// R
+	{0x46, 0x49, 0x49, 0x49, 0x31},	// S
+	{0x01, 0x01, 0x7F, 0x01, 0x01},	// T
+	{0x3F, 0x40, 0x40, 0x40, 0x3F},	// U
+	{0x1F, 0x20, 0x40, 0x20, 0x1F},	// V
+	{0x7F, 0x20, 0x18, 0x20, 0x7F},	// W
+	{0x63, 0x14, 0x08, 0x14, 0x63},	// X
+	{0x03, 0x04, 0x78, 0x04, 0x03},	// Y
+	{0x61, 0x51, 0x49, 0x45, 0x43},	// Z
+	{0x00, 0x7F, 0x41, 0x41, 0x00},	// [
+	{0x02, 0x04, 0x08, 0x10, 0x20},	// backslash
+	{0x00, 0x41, 0x41, 0x7F, 0x00},	// ]
+	{0x04, 0x02, 0x01, 0x02, 0x04},	// ^
+	{0x40, 0x40, 0x40, 0x40, 0x40},	// _
+	{0x00, 0x01, 0x02, 0x04, 0x00},	// `
+	{0x20, 0x54, 0x54, 0x54, 0x78},	// a
+	{0x7F, 0x48, 0x44, 0x44, 0x38},	// b
+	{0x38, 0x44, 0x44, 0x44, 0x20},	// c
+	{0x38, 0x44, 0x44, 0x48, 0x7F},	// d
+	{0x38, 0x54, 0x54, 0x54, 0x18},	// e
+	{0x08, 0x7E, 0x09, 0x01, 0x02},	// f
+	{0x08, 0x54, 0x54, 0x54, 0x3C},	// g
+	{0x7F, 0x08, 0x04, 0x04, 0x78},	// h
+	{0x00, 0x44, 0x7D, 0x40, 0x00},	// i
+	{0x20, 0x40, 0x44, 0x3D, 0x00},	// j
+	{0x7F, 0x10, 0x28, 0x44, 0x00},	// k
+	{0x00, 0x41, 0x7F, 0x40, 0x00},	// l
+	{0x7C, 0x04, 0x18, 0x04, 0x78},	// m
+	{0x7C, 0x08, 0x04, 0x04, 0x78},	// n
+	{0x38, 0x44, 0x44, 0x44, 0x38},	// o
+	{0x7C, 0x14, 0x14, 0x14, 0x08},	// p
+	{0x08, 0x14, 0x14, 0x18, 0x7C},	// q
+	{0x7C, 0x08, 0x04, 0x04, 0x08},	// r
+	{0x48, 0x54, 0x54, 0x54, 0x20},	// s
+	{0x04, 0x3F, 0x44, 0x40, 0x20},	// t
+	{0x3C, 0x40, 0x40, 0x20, 0x7C},	// u
+	{0x1C, 0x20, 0x40, 0x20, 0x1C},	// v
+	{0x3C, 0x40, 0x30, 0x40, 0x3C},	// w
+	{0x44, 0x28, 0x10, 0x28, 0x44},	// x
+	{0x0C, 0x50, 0x50, 0x50, 0x3C},	// y
+	{0x44, 0x64, 0x54, 0x4C, 0x44},	// z
+	{0x00, 0x08, 0x36, 0x41, 0x00},	// {
+	{0x00, 0x00, 0x7F, 0x00, 0x00},	// |
+	{0x00, 0x41, 0x36, 0x08, 0x00},	// }
+	{0x10, 0x08, 0x08, 0x10, 0x08},	// ~
+};
+
+struct glyph
+{
+	int nruns;
+	unsigned char run[GLYPH_H * 3][3];	// row, first column, length
+};
+
+static struct glyph glyphs[FONT_CHARS];
+static char glyph_cached[FONT_CHARS];
+
+static const struct glyph *get_glyph(int c)
+{
+	struct glyph *g;
+	int row, col, start;
+
+	if (c < FONT_FIRST || c >= FONT_FIRST + FONT_CHARS) c = '?';
+	g = &glyphs[c - FONT_FIRST];
+	if (glyph_cached[c - FONT_FIRST]) return g;
+
+	g->nruns = 0;
+	for (row = 0; row < GLYPH_H; ++row)
+		for (col = 0; col < GLYPH_W; ++col)
+		{
+			if (!((font5x7[c - FONT_FIRST][col] >> row) & 1)) continue;
+			for (start = col; col + 1 < GLYPH_W &&
+				 ((font5x7[c - FONT_FIRST][col + 1] >> row) & 1); ++col);
+			g->run[g->nruns][0] = row;
+			g->run[g->nruns][1] = start;
+			g->run[g->nruns][2] = col - start + 1;
+			g->nruns++;
+		}
+	glyph_cached[c - FONT_FIRST] = 1;
+	return g;
+}
+
+/*
+	Draws text with its top left corner at (x, y), each font pixel scale x scale
+	screen pixels. '\n' starts a new line. Clipped to the screen.
+*/
+void draw_text(void *img, int x, int y, const char *text, int scale, color_t c)
+{
+	int cx = x, i;
+	unsigned int px;
+
+	if (!initialized || img == NULL || text == NULL || scale < 1) return;
+	px = to_native(c);
+
+	for (; *text; ++text)
+	{
+		const struct glyph *g;
+		if (*text == '\n')
+		{
+			cx = x;
+			y += (GLYPH_H + 1) * scale;
+			continue;
+		}
+
+		g = get_glyph((unsigned char) *text);
+		for (i = 0; i < g->nruns; ++i)
+		{
+			int x1 = cx + g->run[i][1] * scale, y1 = y + g->run[i][0] * scale;
+			fill_native(img, x1, y1, x1 + g->run[i][2] * scale - 1, y1 + scale - 1, px);
+		}
+		cx += (GLYPH_W + 1) * scale;
+	}
+}
+
+
+/*
+	Filled shapes. Every shape is turned into one horizontal span per row and
+	drawn with fill_native(), so they are clipped to the screen and work inside
+	a batch like fill_rect does.
+*/
+
+/*
+	Finds the covered pixels of a row of n pixels given the three edge function
+	values w at the first pixel and how much they change per pixel (step).
+	Pixels are covered where all three are >= 0, 4 at a time. Triangles are
+	convex so the covered pixels form one run, returned in first/last.
+	Returns 0 if nothing in the row is covered.
+*/
+static int covered_run(const int w[3], const int step[3], int n, int *first, int *last)
+{
+	int x, covered, open = 0;
+#ifdef __SSE2__
+	__m128i e0 = _mm_set_epi32(w[0] + 3*step[0], w[0] + 2*step[0], w[0] + step[0], w[0]),
+			e1 = _mm_set_epi32(w[1] + 3*step[1], w[1] + 2*step[1], w[1] + step[1], w[1]),
+			e2 = _mm_set_epi32(w[2] + 3*step[2], w[2] + 2*step[2], w[2] + step[2], w[2]),
+			s0 = _mm_set1_epi32(4*step[0]), s1 = _mm_set1_epi32(4*step[1]),
+			s2 = _mm_set1_epi32(4*step[2]);
+#else
+	int e[3] = {w[0], w[1], w[2]}, k;
+#endif
+
+	for (x = 0; x < n; x += 4)
+	{
+#ifdef __SSE2__
+		// Sign bit of (e0 | e1 | e2) is set where any edge is negative
+		covered = ~_mm_movemask_ps(_mm_castsi128_ps(
+					_mm_or_si128(_mm_or_si128(e0, e1), e2))) & 0xf;
+		e0 = _mm_add_epi32(e0, s0); e1 = _mm_add_epi32(e1, s1); e2 = _mm_add_epi32(e2, s2);
+#else
+		for (covered = k = 0; k < 4; ++k)
+			if ((e[0] + k*step[0] | e[1] + k*step[1] | e[2] + k*step[2]) >= 0)
+				covered |= 1 << k;
+		e[0] += 4*step[0]; e[1] += 4*step[1]; e[2] += 4*step[2];
+#endif
+		if (n - x < 4) covered &= (1 << (n - x)) - 1; // Past the end of the row
+
+		if (!open)
+		{
+			if (covered == 0) continue;
+			*first = x + __builtin_ctz(covered);
+			covered |= (1 << (*first - x)) - 1; // Lanes before the run don't end it
+			open = 1;
+		}
+		if ((covered & 0xf) != 0xf)
+		{
+			*last = x + __builtin_ctz(~covered) - 1;
+			return 1;
+		}
+	}
+	if (open) *last = n - 1;
+	return open;
+}
+
+/*
+	Fills the triangle with corners (x1, y1), (x2, y2) & (x3, y3) using edge
+	functions. Pixels on an edge shared by two triangles are drawn only once
+	(top-left rule), so meshes don't get double drawn or leave gaps.
+*/
+void fill_triangle(void *img, int x1, int y1, int x2, int y2, int x3, int y3, color_t c)
+{
+	int vx[3], vy[3], w[3], step[3], row[3], i, y, minx, maxx, miny, maxy,
+		first, last, area;
+	unsigned int px;
+
+	if (!initialized || img == NULL) return;
+
+	// Order the corners so the inside of every edge is positive
+	area = (x2 - x1)*(y3 - y1) - (y2 - y1)*(x3 - x1);
+	if (area == 0) return; // Degenerate
+	vx[0] = x1; vy[0] = y1;
+	if (area > 0) { vx[1] = x2; vy[1] = y2; vx[2] = x3; vy[2] = y3; }
+	else		  { vx[1] = x3; vy[1] = y3; vx[2] = x2; vy[2] = y2; }
+
+	// Bounding box, clipped to the screen
+	minx = x1 < x2 ? (x1 < x3 ? x1 : x3) : (x2 < x3 ? x2 : x3);
+	maxx = x1 > x2 ? (x1 > x3 ? x1 : x3) : (x2 > x3 ? x2 : x3);
+	miny = y1 < y2 ? (y1 < y3 ? y1 : y3) : (y2 < y3 ? y2 : y3);
+	maxy = y1 > y2 ? (y1 > y3 ? y1 : y3) : (y2 > y3 ? y2 : y3);
+	if (minx < 0) minx = 0;
+	if (miny < 0) miny = 0;
+	if (maxx >= xres) maxx = xres - 1;
+	if (maxy >= yres) maxy = yres - 1;
+	if (minx > maxx || miny > maxy) return;
+
+	// E(x, y) = dx*(y - ay) - dy*(x - ax) for each edge a->b
+	for (i = 0; i < 3; ++i)
+	{
+		int ax = vx[i], ay = vy[i], dx = vx[(i + 1) % 3] - ax, dy = vy[(i + 1) % 3] - ay;
+		step[i] = -dy;
+		row[i] = dx*(miny - ay) - dy*(minx - ax);
+		if (!((dy == 0 && dx > 0) || dy < 0)) row[i]--; // Only top & left edges own their pixels
+		w[i] = dx; // Change per row
+	}
+
+	px = to_native(c);
+	for (y = miny; y <= maxy; ++y)
+	{
+		if (covered_run(row, step, maxx - minx + 1, &first, &last))
+			fill_native(img, minx + first, y, minx + last, y, px);
+		row[0] += w[0]; row[1] += w[1]; row[2] += w[2];
+	}
+}
+
+/*
+	Fills a convex polygon with n corners (x[i], y[i]) by scanlines. For each
+	row y the edges crossing the line at y (pixel coordinates are sampled at
+	their integer point, as in fill_triangle) give the ends of the span. Like
+	triangles, top & left edges are drawn and bottom & right edges aren't.
+*/
+void fill_polygon(void *img, const int *x, const int *y, int n, color_t c)
+{
+	int i, row, miny, maxy;
+	unsigned int px;
+
+	if (!initialized || img == NULL || x == NULL || y == NULL || n < 3) return;
+
+	for (miny = maxy = y[0], i = 1; i < n; ++i)
+	{
+		if (y[i] < miny) miny = y[i];
+		if (y[i] > maxy) maxy = y[i];
+	}
+	if (miny < 0) miny = 0;
+	if (maxy > yres) maxy = yres;
+
+	px = to_native(c);
+	for (row = miny; row < maxy; ++row)
+	{
+		long long left = LLONG_MAX, right = LLONG_MIN; // 16.16 fixed point
+		for (i = 0; i < n; ++i)
+		{
+			int ax = x[i], ay = y[i], bx = x[(i + 1) % n], by = y[(i + 1) % n];
+			long long cross;
+			if (ay == by) continue;
+			if (ay > by) { int t = ax; ax = bx; bx = t; t = ay; ay = by; by = t; }
+			if (row < ay || row >= by) continue; // Top inclusive, bottom exclusive
+
+			cross = ((long long) ax << 16) + ((long long) (bx - ax) * (row - ay) << 16) / (by - ay);
+			if (cross < left) left = cross;
+			if (cross > right) right = cross;
+		}
+		if (left > right) continue;
+
+		// Pixels whose x is in [left, right)
+		fill_native(img, (int) ((left + 0xffff) >> 16), row,
+						 (int) ((right + 0xffff) >> 16) - 1, row, px);
+	}
+}
+
+/*
+	Fills the ellipse centered at (cx, cy) with radii rx & ry. The half width of
+	each row is found incrementally from the one before it, no square roots.
+*/
+void fill_ellipse(void *img, int cx, int cy, int rx, int ry, color_t c)
+{
+	long long rx2 = (long long) rx * rx, ry2 = (long long) ry * ry;
+	int dx = rx, dy;
+	unsigned int px;
+
+	if (!initialized || img == NULL || rx < 0 || ry < 0) return;
+	px = to_native(c);
+
+	for (dy = 0; dy <= ry; ++dy)
+	{
+		// Shrink until (dx/rx)^2 + (dy/ry)^2 <= 1
+		while (dx > 0 && dx*dx*ry2 + dy*dy*rx2 > rx2*ry2) dx--;
+		fill_native(img, cx - dx, cy + dy, cx + dx, cy + dy, px);
+		if (dy > 0) fill_native(img, cx - dx, cy - dy, cx + dx, cy - dy, px);
+	}
+}
+
+void fill_circle(void *img, int cx, int cy, int r, color_t c)
+{
+	fill_ellipse(img, cx, cy, r, r, c);
+}
+
+// Blends c over one pixel with opacity a (0-255), if it's on the screen
+static void blend_pixel(char *img, int x, int y, color_t c, int a)
+{
+	color_t d;
+	unsigned char alpha = a;
+	char *p = img + y*stride + x*bytespp;
+
+	if (x < 0 || x >= xres || y < 0 || y >= yres || a <= 0) return;
+	ops.unconvert(&d, p, 1);
+	blend_row(&d, &c, &alpha, 1, -1);
+	ops.convert(p, &d, 1);
+}
+
+/*
+	Anti-aliased line (Xiaolin Wu's algorithm). Each step along the major axis
+	splits the color between the two pixels closest to the ideal line. The
+	position is kept in 16.16 fixed point. Pixels off the screen are skipped.
+*/
+void draw_line_aa(void *img, int x1, int y1, int x2, int y2, color_t c)
+{
+	int steep = abs(y2 - y1) > abs(x2 - x1), t, x;
+	long pos, grad;
+
+	if (!initialized || img == NULL) return;
+	flush_batch(img);
+
+	if (steep) { t = x1; x1 = y1; y1 = t; t = x2; x2 = y2; y2 = t; }
+	if (x1 > x2) { t = x1; x1 = x2; x2 = t; t = y1; y1 = y2; y2 = t; }
+
+	grad = x2 == x1 ? 0 : ((long) (y2 - y1) << 16) / (x2 - x1);
+	pos = (long) y1 << 16;
+	for (x = x1; x <= x2; ++x, pos += grad)
+	{
+		int y = (int) (pos >> 16), frac = (int) ((pos >> 8) & 0xff);
+		if (steep)
+		{
+			blend_pixel(img, y, x, c, 255 - frac);
+			blend_pixel(img, y + 1, x, c, frac);
+		}
+		else
+		{
+			blend_pixel(img, x, y, c, 255 - frac);
+			blend_pixel(img, x, y + 1, c, frac);
+		}
+	}
+}
+
+
+/*
+	Adds one command to the batch, growing the buffer as needed
+*/
+static void record(int type, int x1, int y1, int x2, int y2, unsigned int px)
+{
+	if (ncmds == cmdcap)
+	{
+		struct draw_cmd *grown;
+		int cap = cmdcap ? cmdcap * 2 : 1024;
+		if ((grown = realloc(cmds, cap * sizeof(struct draw_cmd))) == NULL) return;
+		cmds = grown; cmdcap = cap;
+	}
+	cmds[ncmds].type = type;
+	cmds[ncmds].x1 = x1; cmds[ncmds].y1 = y1;
+	cmds[ncmds].x2 = x2; cmds[ncmds].y2 = y2;
+	cmds[ncmds].px = px;
+	ncmds++;
+}
+
+/*
+	Draws every command that touches tile t, clipped to the tile
+*/
+static void render_tile(int t)
+{
+	int tx0 = (t % tiles_x) * TILE_SIZE, ty0 = (t / tiles_x) * TILE_SIZE,
+		tx1 = tx0 + TILE_SIZE, ty1 = ty0 + TILE_SIZE, i;
+
+	if (tx1 > xres) tx1 = xres;
+	if (ty1 > yres) ty1 = yres;
+
+	for (i = bin_start[t]; i < bin_start[t + 1]; ++i)
+	{
+		struct draw_cmd *c = &cmds[bins[i]];
+		if (c->type == CMD_RECT)
+		{
+			int x0 = c->x1 > tx0 ? c->x1 : tx0, x1 = c->x2 < tx1 ? c->x2 : tx1 - 1,
+				y0 = c->y1 > ty0 ? c->y1 : ty0, y1 = c->y2 < ty1 ? c->y2 : ty1 - 1;
+			char *p = batch_img + y0*stride + x0*bytespp;
+			for (; y0 <= y1; ++y0, p += stride)
+				ops.span(p, x1 - x0 + 1, c->px);
+		}
+		else ops.clipline(batch_img, c->x1, c->y1, c->x2, c->y2, c->px,
+						  tx0, ty0, tx1, ty1);
+	}
+}
+
+// Hands out tiles until there are none left. Each tile goes to one thread only.
+static void render_tiles(void)
+{
+	int t;
+	while ((t = __sync_fetch_and_add(&next_tile, 1)) < ntiles)
+		render_tile(tile_order[t]);
+}
+
+/*
+	Cell d of the order n Hilbert curve over a 2^n x 2^n grid. Each level of d
+	(2 bits, lowest first) picks a quadrant & rotates the cell found so far
+	into it, so consecutive d are always neighbours.
+*/
+void hilbert_d2xy(int n, int d, int *x, int *y)
+{
+	int s, rx, ry, t;
+
+	*x = *y = 0;
+	for (s = 1; s < 1 << n; s *= 2, d /= 4)
+	{
+		rx = (d >> 1) & 1;
+		ry = (d ^ rx) & 1;
+		if (ry == 0)
+		{
+			if (rx) { *x = s - 1 - *x; *y = s - 1 - *y; }
+			t = *x; *x = *y; *y = t;
+		}
+		*x += s * rx;
+		*y += s * ry;
+	}
+}
+
+/*
+	Tiles in Hilbert curve order (over the smallest power of 2 square that holds
+	the grid, skipping cells off it). Tiles rendered one after another are next
+	to each other, so a thread moving on mostly finds the frame buffer rows &
+	the commands of the last tile still in its cache.
+*/
+static void order_tiles(void)
+{
+	int n = 0, d, x, y, k = 0;
+
+	while ((1 << n) < tiles_x || (1 << n) < tiles_y) ++n;
+	for (d = 0; d < 1 << (2*n); ++d)
+	{
+		hilbert_d2xy(n, d, &x, &y);
+		if (x < tiles_x && y < tiles_y) tile_order[k++] = y*tiles_x + x;
+	}
+}
+
+// arg is the batch generation the worker was started in
+static void *render_worker(void *arg)
+{
+	int gen = (int) (intptr_t) arg;
+
+	pthread_mutex_lock(&pool_lock);
+	while (1)
+	{
+		while (gen == pool_gen && !pool_quit)
+			pthread_cond_wait(&pool_wake, &pool_lock);
+		if (pool_quit) break;
+		gen = pool_gen;
+		pthread_mutex_unlock(&pool_lock);
+
+		render_tiles();
+
+		pthread_mutex_lock(&pool_lock);
+		if (--pool_busy == 0) pthread_cond_signal(&pool_done);
+	}
+	pthread_mutex_unlock(&pool_lock);
+	return NULL;
+}
+
+static void stop_workers(void)
+{
+	int i;
+	pthread_mutex_lock(&pool_lock);
+	pool_quit = 1;
+	pthread_cond_broadcast(&pool_wake);
+	pthread_mutex_unlock(&pool_lock);
+
+	for (i = 0; i < pool_size; ++i)
+		pthread_join(workers[i], NULL);
+	pool_size = pool_quit = 0;
+}
+
+// Threads end_batch() should render with, the caller included
+static int wanted_threads(void)
+{
+	int want = render_threads > 0 ? render_threads :
+			   (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (want > MAX_RENDER_THREADS) want = MAX_RENDER_THREADS;
+	return want < 1 ? 1 : want;
+}
+
+// (Re)starts the pool so it has the requested number of workers
+static void start_workers(void)
+{
+	int want = wanted_threads();
+
+	if (want - 1 == pool_size) return;
+
+	stop_workers();
+	for (pool_size = 0; pool_size < want - 1; ++pool_size)
+		if (pthread_create(&workers[pool_size], NULL, render_worker,
+						   (void *) (intptr_t) pool_gen) != 0)
+			break;
+}
+
+/*
+	Sets how many threads end_batch() renders with. 0 (the default) uses one
+	per online CPU.
+*/
+void set_render_threads(int n)
+{
+	render_threads = n < 0 ? 0 : n;
+}
+
+/*
+	Starts recording. Until end_batch() is called draw_pixel, draw_line and
+	fill_rect on img are queued instead of drawn. Drawing to other buffers
+	still happens right away.
+*/
+void begin_batch(void *img)
+{
+	if (initialized && img != NULL)
+	{
+		if (batch_img != NULL) end_batch();
+		batch_img = img;
+		ncmds = 0;
+	}
+}
+
+/*
+	Rasterizes everything recorded since begin_batch() in parallel, one tile
+	per thread at a time, handed out in Hilbert curve order. Returns once the
+	buffer is complete. With one thread, or fewer than BATCH_MIN_CMDS
+	commands, binning costs more than it saves & they're drawn in order.
+*/
+void end_batch()
+{
+	int i, t, tx, ty, total = 0, *fill;
+
+	if (!initialized || batch_img == NULL) return;
+
+	if (ncmds < BATCH_MIN_CMDS || wanted_threads() == 1)
+	{
+		for (i = 0; i < ncmds; ++i)
+		{
+			struct draw_cmd *c = &cmds[i];
+			if (c->type == CMD_RECT)
+			{
+				char *p = batch_img + c->y1*stride + c->x1*bytespp;
+				for (t = c->y1; t <= c->y2; ++t, p += stride)
+					ops.span(p, c->x2 - c->x1 + 1, c->px);
+			}
+			else ops.clipline(batch_img, c->x1, c->y1, c->x2, c->y2, c->px,
+							  0, 0, xres, yres);
+		}
+		batch_img = NULL;
+		ncmds = 0;
+		return;
+	}
+
+	tiles_x = (xres + TILE_SIZE - 1) / TILE_SIZE;
+	tiles_y = (yres + TILE_SIZE - 1) / TILE_SIZE;
+	ntiles = tiles_x * tiles_y;
+
+	if ((fill = calloc(ntiles + 1, sizeof(int))) == NULL ||
+		(bin_start == NULL &&
+		 (bin_start = malloc((ntiles + 1) * sizeof(int))) == NULL))
+	{
+		free(fill); batch_img = NULL; return;
+	}
+	if (tile_order == NULL)
+	{
+		if ((tile_order = malloc(ntiles * sizeof(int))) == NULL)
+		{
+			free(fill); batch_img = NULL; return;
+		}
+		order_tiles();
+	}
+
+	// Count how many commands land in each tile (by bounding box)
+	for (i = 0; i < ncmds; ++i)
+	{
+		struct draw_cmd *c = &cmds[i];
+		int x0 = c->x1 < c->x2 ? c->x1 : c->x2, x1 = c->x1 < c->x2 ? c->x2 : c->x1,
+			y0 = c->y1 < c->y2 ? c->y1 : c->y2, y1 = c->y1 < c->y2 ? c->y2 : c->y1;
+		for (ty = y0 / TILE_SIZE; ty <= y1 / TILE_SIZE; ++ty)
+			for (tx = x0 / TILE_SIZE; tx <= x1 / TILE_SIZE; ++tx)
+				fill[ty*tiles_x + tx]++;
+	}
+
+	// Prefix sum gives each tile its slice of bins
+	for (t = 0; t < ntiles; ++t)
+	{
+		bin_start[t] = total;
+		total += fill[t];
+		fill[t] = bin_start[t];
+	}
+	bin_start[ntiles] = total;
+
+	if (total > bincap)
+	{
+		int *grown = realloc(bins, total * sizeof(int));
+		if (grown == NULL) { free(fill); batch_img = NULL; return; }
+		bins = grown; bincap = total;
+	}
+
+	// Second pass files the commands, keeping recording order within a tile
+	for (i = 0; i < ncmds; ++i)
+	{
+		struct draw_cmd *c = &cmds[i];
+		int x0 = c->x1 < c->x2 ? c->x1 : c->x2, x1 = c->x1 < c->x2 ? c->x2 : c->x1,
+			y0 = c->y1 < c->y2 ? c->y1 : c->y2, y1 = c->y1 < c->y2 ? c->y2 : c->y1;
+		for (ty = y0 / TILE_SIZE; ty <= y1 / TILE_SIZE; ++ty)
+			for (tx = x0 / TILE_SIZE; tx <= x1 / TILE_SIZE; ++tx)
+				bins[fill[ty*tiles_x + tx]++] = i;
+	}
+	free(fill);
+
+	// Kick the workers & render alongside them
+	start_workers();
+	pthread_mutex_lock(&pool_lock);
+	next_tile = 0;
+	pool_busy = pool_size;
+	pool_gen++;
+	pthread_cond_broadcast(&pool_wake);
+	pthread_mutex_unlock(&pool_lock);
+
+	render_tiles();
+
+	pthread_mutex_lock(&pool_lock);
+	while (pool_busy > 0)
+		pthread_cond_wait(&pool_done, &pool_lock);
+	pthread_mutex_unlock(&pool_lock);
+
+	batch_img = NULL;
+	ncmds = 0;
+}
@@ -0,0 +1,152 @@
+/****************************************************************
+*	Author: Nicolas Leo                    						*
+*	Class: CS 1550, 9/17/18                						*
+*	Project 1: Double-Buffered Graphics Library					*
+*	Description: Plays back a recording made with record_start()*
+*   (or FB_RECORD=file) on the frame buffer, or headless.       *
+*   Usage: play file [-f], -f plays as fast as it can & prints  *
+*   the decoding rate. 'q' stops.                               *
+****************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "graphics.h"
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static unsigned int get16(const unsigned char *p)
+{
+	uint16_t u;
+	memcpy(&u, p, 2);
+	return u;
+}
+
+/*
+	Decodes n pixels of runs from p into out. Returns the end of the runs, or
+	NULL if they don't fit in [p, end) or make more than n pixels.
+*/
+static const unsigned char *decode_runs(const unsigned char *p, const unsigned char *end,
+	color_t *out, int n)
+{
+	int i = 0, j, k, literal;
+
+	while (i < n)
+	{
+		if (end - p < 2) return NULL;
+		k = get16(p) & 0x7fff;
+		literal = get16(p) & 0x8000;
+		if (k == 0 || i + k > n || end - p - 2 < (literal ? k * 2 : 2)) return NULL;
+		if (literal)
+			memcpy(out + i, p + 2, k * 2);
+		else
+			for (j = 0; j < k; ++j) out[i + j] = (color_t) get16(p + 2);
+		p += 2 + (literal ? k * 2 : 2);
+		i += k;
+	}
+	return p;
+}
+
+int main(int argc, char **argv)
+{
+	FILE *in;
+	uint16_t head[6];
+	uint32_t fh[2];
+	unsigned char *frame = NULL;
+	color_t tile[64*64];
+	sprite_t sp;
+	event_t ev;
+	void *buf;
+	long frames = 0, bytes = 0, cap = 0;
+	int fast = argc > 2 && strcmp(argv[2], "-f") == 0, w, h, ts, tx, bad = 0;
+	double start, took;
+
+	if (argc < 2 || (in = fopen(argv[1], "rb")) == NULL)
+	{
+		puts("Usage: play file [-f]");
+		return 1;
+	}
+	if (fread(head, 2, 6, in) != 6 || memcmp(head, "FBR1", 4) != 0 ||
+		head[4] == 0 || head[4] > 64)
+	{
+		puts("Not a recording");
+		return 1;
+	}
+	w = head[2]; h = head[3]; ts = head[4];
+	tx = (w + ts - 1) / ts;
+
+	init_graphics();
+	buf = new_offscreen_buffer();
+	sp.pixels = tile;
+	sp.alpha = NULL;
+	sp.colorkey = -1;
+	start = now_ms();
+
+	while (fread(fh, 4, 2, in) == 2)
+	{
+		const unsigned char *p, *end;
+		int n, i, x1 = w, y1 = h, x2 = 0, y2 = 0;
+
+		if (fh[1] > cap && (frame = realloc(frame, cap = fh[1])) == NULL) break;
+		if (fread(frame, 1, fh[1], in) != fh[1] || fh[1] < 2) { bad = 1; break; }
+		p = frame + 2;
+		end = frame + fh[1];
+		n = get16(frame);
+
+		for (i = 0; i < n && p != NULL; ++i)
+		{
+			int t, x, y;
+			if (end - p < 2) { p = NULL; break; }
+			t = get16(p);
+			x = t % tx * ts;
+			y = t / tx * ts;
+			if (y >= h) { p = NULL; break; }
+			sp.w = w - x < ts ? w - x : ts;
+			sp.h = h - y < ts ? h - y : ts;
+			if ((p = decode_runs(p + 2, end, tile, sp.w * sp.h)) == NULL) break;
+			blit_sprite(buf, &sp, x, y);
+			if (x < x1) x1 = x;
+			if (y < y1) y1 = y;
+			if (x + sp.w > x2) x2 = x + sp.w;
+			if (y + sp.h > y2) y2 = y + sp.h;
+		}
+		if (p == NULL) { bad = 1; break; }
+
+		// Show it when it was shown, watching for 'q' meanwhile
+		if (!fast)
+		{
+			double wait;
+			while ((wait = start + fh[0] - now_ms()) > 0)
+			{
+				if (wait_event(&ev, (long) wait + 1))
+				{
+					if (ev.key == 'q') break;
+				}
+				else if ((wait = start + fh[0] - now_ms()) > 0)
+					sleep_ms((long) wait + 1); // Input is closed, wait_event() won't wait
+			}
+			if (wait > 0) break;
+		}
+		if (x1 < x2) blit_rect(buf, x1, y1, x2 - x1, y2 - y1);
+		frames++;
+		bytes += 8 + fh[1];
+	}
+	took = now_ms() - start;
+	exit_graphics();
+	fclose(in);
+	free(frame);
+
+	if (bad) puts("Recording is damaged, stopped there");
+	printf("%ld frames, %ld bytes (%.1f per frame, %.1f%% of raw RGB565) in %.0f ms",
+		frames, bytes, frames ? (double) bytes / frames : 0.0,
+		frames ? 100.0 * bytes / frames / (2.0 * w * h) : 0.0, took);
+	if (fast && took > 0) printf(", %.0f frames/s", frames / (took / 1000.0));
+	putchar('\n');
+	return 0;
+}
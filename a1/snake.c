@@ -3,44 +3,52 @@
 *	Class: CS 1550, 9/17/18                						*
 *	Project 1: Double-Buffered Graphics Library					*
 *	Description: Simple snake game to test the graphics library	*
-*   There are still a few bug (segmentation faults) but a decent*
-*   Demo to see the functions in action.                        *
+*   A move costs the same whatever the board size: the body is  *
+*   a ring buffer, food goes in a random cell of a free set, &  *
+*   only the cells that changed are redrawn & blitted.          *
 ****************************************************************/
 
 
-// There were issues in the original file with food(), draw_box, and when the user pressed 
-// the left arrow key to move to the left. All problems have been fixed. 
+// There were issues in the original file with food(), draw_box, and when the user pressed
+// the left arrow key to move to the left. All problems have been fixed.
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <math.h>
+#include <unistd.h>
 #include "graphics.h"
 
 #define SIZE 80 // Works best with 1, 5, 10, 20, 40, 80, or 160
 //at this resolution
 //8x6
 
-typedef struct
-{
-	int index;
-	struct Node *next;
-} Node;
+#define FREE  1 // Values of the board's cells
+#define SNAKE 0
+#define FOOD  2
+
+// The snake's cells, tail first, in a ring buffer of maxIndex cells. The head
+// is body[(tail + length - 1) % maxIndex]. Allocated once, nothing per move.
+static int *body = NULL;
+static int tail = 0;
+static int length = 0;
 
-// Linked list implementation to keep track of & change cells on the board
-// Works in conjunction with the char array board.
-static Node *firstNode = NULL;
-static Node *lastNode = NULL;
-static Node *tempN = NULL;
-static int length = 1;
+// Free cells (no snake, no food) in any order, & where each one is in that
+// array (-1 if it isn't free), so taking a cell out or putting one back is a
+// swap with the last one.
+static int *freeCells = NULL, *freePos = NULL;
+static int nfree = 0;
 
 static int maxIndex; // Used to keep track fo the board's index
 
 static void addNode(int, int , char *, void *);
 static void draw_box(void *, int, int, int, color_t);
 static void draw_bg(void *, color_t);
+static void draw_cell(void *, int, color_t);
+static void take_free(int);
+static void put_free(int);
 
 static int boardxmax, boardymax; // Max tiles for a given resolution (#defined SIZE)
-static void food(void*, int, int, int, char *); // Puts food on the board for the snake
+static void food(void*, char *); // Puts food on the board for the snake
 
 
 int main(int argc, char const *argv[])
@@ -56,104 +64,98 @@ int main(int argc, char const *argv[])
 	srand((unsigned int)time(0)); 	//Seed the random # generator, used for making food
 	unsigned char move = 1;			// Keeps track of the user's last move
 
-	
+
 	void *buf = new_offscreen_buffer(); //Construct an off-screen buffer to draw to
 
-	static char key;
-	// Holds individual key presses using the getkey() function Non-blocking
+	event_t ev = {0}; // Key presses, arrow keys come back as KEY_UP etc.
 
-	static char ikey [3]= {0, 0, 0}; 
-	//used for initial read to block the program from progressing
-	// until the user presses an arrow key
-	
 	boardxmax = 640/SIZE; //Used for offsetting printing of the blocks of pixels
 	boardymax = 480/SIZE;
 
 
 	// Calculate how many blocks can fit on the screen at this resolutions
-	int t = (int)((640.0*480.0)/(SIZE *SIZE)); // Temp variable for calculations
+	int t = boardxmax * boardymax; // Temp variable for calculations
 
 	maxIndex = t;
-	char board [t]; // Used to keep track of legal spaces on the board. 
+	// Used to keep track of legal spaces on the board. On the heap, a small SIZE
+	// makes it too big for the stack.
+	char *board = malloc(t);
+	body = malloc(t * sizeof (int));
+	freeCells = malloc(t * sizeof (int));
+	freePos = malloc(t * sizeof (int));
+	if (board == NULL || body == NULL || freeCells == NULL || freePos == NULL || buf == NULL)
+	{
+		exit_graphics();
+		puts("Out of memory");
+		return 1;
+	}
 
-	int i; 
+	int i;
 	for (i = 0; i < t; ++i)
-		board[i] = 1;
+	{
+		board[i] = FREE;
+		freeCells[i] = freePos[i] = i;
+	}
+	nfree = t;
 
 	//Snake starts out in the middle of the board
 	int head = (t/2 + ((((t/2)%boardxmax )== 0 )? boardxmax/2 -1: -1));
-	board[head] = 0;
 
-	
+
 	draw_bg(buf, RGB(31, 63, 31));
 	addNode(head, length + 1, board, buf);
 	blit(buf);
 
 	//block until the user presses one of the arrow keys, exit otherwise
-	read(0, &ikey, 3);
+	wait_event(&ev, -1);
 
 	//Skip to the switch statement inside the do-while loop below
-	if(ikey[0]== '\033' && ikey[1] == '[')
-	{
-		if(ikey[2]== 'A')		{move = 1; } // Up arrow 
-		else if(ikey[2] == 'B') {move = 2; } // Down arrow 
-		else if(ikey[2] == 'C') {move = 3; } // Right arrow 
-		else if(ikey[2] == 'D') {move = 4; } // Left arrow 
-	}
-	else 
+	if(ev.key == KEY_UP)		{move = 1; } // Up arrow
+	else if(ev.key == KEY_DOWN) {move = 2; } // Down arrow
+	else if(ev.key == KEY_RIGHT){move = 3; } // Right arrow
+	else if(ev.key == KEY_LEFT) {move = 4; } // Left arrow
+	else
 		move = 0; //exit the game if the user doesn't press an arrow key
 
+	frame_rate(400); // The snake moves one cell every 400 ms
 	while(move > 0)
 	{
-		blit(buf);
-		sleep_ms(400);
-		key = getkey();
-
-		if (key == 'q')
+		// Handle the keys pressed until it's time for the next move
+		while (frame_event(&ev))
 		{
-			move = 0;
-		}	
-		else if (key == '\033' && getkey() == '[') 
-		{ // if the first value is esc
-			key = getkey();
-			if(key== 'A')		{move = 1; } // Up arrow 
-			else if(key == 'B') {move = 2; } // Down arrow 
-			else if(key == 'C') {move = 3; } // Right arrow 
-			else if(key == 'D') {move = 4; } // Left arrow 
-    	}
-	
-		key = '\0';
-
-		if(move == 1)		// Up arrow 	
+			if (ev.key == 'q')			 { move = 0; break; }
+			else if(ev.key == KEY_UP)	 move = 1; // Up arrow
+			else if(ev.key == KEY_DOWN)	 move = 2; // Down arrow
+			else if(ev.key == KEY_RIGHT) move = 3; // Right arrow
+			else if(ev.key == KEY_LEFT)	 move = 4; // Left arrow
+		}
+		if (move == 0) break;
+
+		if(move == 1)		// Up arrow
 		{
 			head -= boardxmax; // Snake's head moves up one row.
 			head = head < 0 ? (head + maxIndex): head; // Verify legal address
-			i = 1;
-		} 
-		else if(move == 2) // Down arrow 
-		{	
+		}
+		else if(move == 2) // Down arrow
+		{
 			head += boardxmax; // Snake's head moves up one row.
 			head = (head < maxIndex) ? head: (head - maxIndex); // Verify legal address
-			i = 2;
-		} 
-		else if(move == 3) // Right arrow 
+		}
+		else if(move == 3) // Right arrow
 		{	// Snake's head moves to the right one cell
-			head ++; 
-			head = head % boardxmax == 0 ? head - boardxmax: head;  
-			i = 3;
+			head ++;
+			head = head % boardxmax == 0 ? head - boardxmax: head;
 		}
-		else if(move == 4) // Left arrow 
+		else if(move == 4) // Left arrow
 		{	// Snake's head moves to the left one cell
 			head--;
 			head = (head < 0) || (head % boardxmax == boardxmax-1)? (head + boardxmax):head;
-			//head = (head < 0) || (head % boardxmax == 1) ? (head + boardxmax): head;
-			i = 4;
-		} 
+		}
 
 		if (head < 0 || head >= maxIndex)
 			break;
 
-		if(board[head]==0) //End of the game
+		if(board[head]==SNAKE) //End of the game
 		{
 			draw_bg(buf, RGB(31, 0, 0));
 			blit(buf);
@@ -161,129 +163,105 @@ int main(int argc, char const *argv[])
 			draw_bg(buf, RGB(0, 63, 0));
 			blit(buf);
 			sleep_ms(200);
-			i = 0;
 			move = 0;
-		}	
-		else if (board[head] == 2) // Snake ate some food, only head moves
+		}
+		else if (board[head] == FOOD) // Snake ate some food, only head moves
 		{
 			addNode(head, length + 1, board, buf);
-		}	
+		}
 		else // No food, head & tail moves
 			addNode(head, length, board, buf);
 	}
 
-	
 
-	exit_graphics();
 
-	if (i !=0)
-		printf("Problem with #%d's calculation\n", i);
+	exit_graphics();
 
 	write(1, "Game Over\n", 10);
 	if (maxIndex == length) puts("Congratulations, you had a perfect score!");
 	else	printf("You scored %d\n", length-1);
 
-	//Free any remaining nodes
-	tempN = firstNode;
-	while(firstNode)
-	{	
-		tempN = firstNode;
-		firstNode = (Node *) (firstNode -> next);
-		free(tempN);
-	}
-
+	free(board); free(body); free(freeCells); free(freePos);
 	return 0;
 }
 
 
 // Draws a box/sqare on the screen at a given left coordinate
 static void draw_box(void *img, int x, int y, int size, color_t c)
-{	
-	static int i;
-	for (i = 0; i < size; ++i)
-		draw_line(img, x, y + i, x+size-1, y + i, c);
-		// draw_line(img, x, y + i, x+size, y + i, c); Fixed segmentation fault
+{
+	fill_rect(img, x, y, size, size, c);
 }
 
 
 // Fills in the background with a solid color
 static void draw_bg(void *img, color_t c)
-{	
-	static int i;
-	for (i = 0; i < 480; ++i)
-		draw_line(img, 0, i, 639, i, c);
+{
+	fill_rect(img, 0, 0, 640, 480, c);
 }
 
-// Puts food on the board for the snake to eat
-static void food(void * img, int size, int cols, int rows, char * board)
+// Colors one cell of the board & puts just that cell on the screen
+static void draw_cell(void *img, int cell, color_t c)
 {
-	if(length<maxIndex) // Added check to make sure there were free boxes
-	{
-		static int x; x = rand()%cols;
-		static int y; y= rand()%rows;
-		static char boolean;
-		int t = x + cols*y;
+	int x = (cell%boardxmax)*SIZE, y = (cell/boardxmax)*SIZE;
+	draw_box(img, x, y, SIZE, c);
+	blit_rect(img, x, y, SIZE, SIZE);
+}
 
-		boolean = 1; 
-		while(boolean)
-		{
-			x = rand()%cols; 
-			y= rand()%rows; 
-			t = x + cols*y;
-			if (t < maxIndex && t > -1 && board[t] == 1)
-				boolean = 0;
-		}
+// Takes a cell out of the free set
+static void take_free(int cell)
+{
+	int last = freeCells[--nfree];
+	freeCells[freePos[cell]] = last;
+	freePos[last] = freePos[cell];
+	freePos[cell] = -1;
+}
 
-		board[t] = 2;
+// Puts a cell back in the free set
+static void put_free(int cell)
+{
+	freePos[cell] = nfree;
+	freeCells[nfree++] = cell;
+}
 
-		draw_box(img, x*size, y*size, size, RGB(31, 0, 0));
+// Puts food on the board for the snake to eat
+static void food(void * img, char * board)
+{
+	if(nfree > 0) // Added check to make sure there were free boxes
+	{
+		int t = freeCells[rand() % nfree]; // Any free cell, no retries however full the board is
+		take_free(t);
+		board[t] = FOOD;
+		draw_cell(img, t, RGB(31, 0, 0));
 	}
 }
 
 
-// Used to add new nodes & keep track of setting the colors 
+// Moves the head to data, the tail follows unless the snake grows (newLen > length)
 static void addNode(int data, int newLen, char * board, void * img)
 {
-	//First node will serve as the snake's tail. The last node will be its head & where new
-	//nodes are added to the linked list. 
+	int grow = newLen > length;
 
-	if (firstNode == NULL)
+	// Free the tail's cell first, then the head can take it
+	if (!grow)
 	{
-		firstNode = malloc(sizeof (Node)); //Create a new node & link to end of the list
-		firstNode -> index = data;
-		firstNode -> next = NULL;
-		lastNode = firstNode;
-		length = 1; board[data] = 0;
-		food(img, SIZE, boardxmax, boardymax, board);
-	}
-	else
-	{		
-		//Create a new node & link to end of the list
-		lastNode -> next = malloc(sizeof (Node)); 
-		lastNode = (Node *)(lastNode -> next); 	//Move pointer to the new node
-		lastNode -> index = data;				//Set the data 
-		lastNode -> next = NULL;				//Set .next of the current node to null
-		board[data] = 0;
-
-		// If the snake ate the food, put more on the board
-		if (newLen > length)
-		{
-			length++; 
-			food(img, SIZE, boardxmax, boardymax, board);
-		} 
-		else // Mark tail (head node) as free & change the color
-		{
-			int data2 = firstNode -> index;
-			board[data2] = 1; 
-			tempN = firstNode;
-			firstNode = (Node *)(firstNode -> next);
-
-			free(tempN);
-			// End of snake disappears
-			draw_box(img, (data2%boardxmax)*SIZE, 
-				(data2/boardxmax)*SIZE, SIZE, RGB(31, 63, 31));
-		}
+		int data2 = body[tail];
+		tail = (tail + 1) % maxIndex;
+		length--;
+		board[data2] = FREE;
+		put_free(data2);
+		// End of snake disappears
+		draw_cell(img, data2, RGB(31, 63, 31));
 	}
+
+	if (board[data] == FREE) take_free(data); // Food isn't in the free set
+	board[data] = SNAKE;
+	body[(tail + length) % maxIndex] = data;
+	length++;
+
+	// If the snake ate the food (or was just placed), put more on the board
+	if (grow)
+		food(img, board);
+
 	// Color in new box green
-	draw_box(img, (data%boardxmax)*SIZE, (data/boardxmax)*SIZE, SIZE, RGB(0, 63, 0));
+	draw_cell(img, data, RGB(0, 63, 0));
 }
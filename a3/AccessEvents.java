@@ -0,0 +1,18 @@
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    What a simulator reports about each access. A simulator without a listener
+    (vmsim -q, sweeps) skips the calls entirely, so quiet runs pay nothing for output.
+ */
+interface AccessEvents
+{
+    // The page was in the PT
+    void hit(long address);
+
+    // The page was brought into a free frame
+    void fault(long address);
+
+    // The page replaced page, which was written to disk first if dirty
+    void evict(long address, boolean dirty, long page);
+}
@@ -0,0 +1,70 @@
+import java.io.*;
+
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    Prints every access ("0x0041f7a0 - HIT" etc.) to stdout. The lines are built
+    straight into one large byte buffer with hand-rolled hex, so printing a
+    million accesses doesn't mean a million printf calls.
+ */
+class AccessPrinter implements AccessEvents
+{
+    private static final byte[] HEX = "0123456789abcdef".getBytes();
+    private static final byte[] HIT = " - HIT\n".getBytes(),
+                                FAULT = " - FAULT - no eviction\n".getBytes(),
+                                DIRTY = " - FAULT - evict dirty (".getBytes(),
+                                CLEAN = " - FAULT - evict clean (".getBytes();
+
+    private final OutputStream out = new FileOutputStream(FileDescriptor.out);
+    private final byte[] buf = new byte[1 << 16];
+    private int pos = 0;
+
+    public void hit(long address)
+    {
+        hex(address, 8);
+        bytes(HIT);
+    }
+
+    public void fault(long address)
+    {
+        hex(address, 8);
+        bytes(FAULT);
+    }
+
+    public void evict(long address, boolean dirty, long page)
+    {
+        hex(address, 8);
+        bytes(dirty ? DIRTY : CLEAN);
+        hex(page, 1);
+        buf[pos++] = ')';
+        buf[pos++] = '\n';
+    }
+
+    /**
+        Writes out what's buffered. Call before printing anything else to stdout.
+    */
+    void flush()
+    {
+        try { out.write(buf, 0, pos); }
+        catch (IOException e) {}
+        pos = 0;
+    }
+
+    // "0x" then v in hex, zero padded to at least digits digits (like %08x / %#x)
+    private void hex(long v, int digits)
+    {
+        if (pos > buf.length - 64) flush(); // Room for a whole line
+        digits = Math.max(digits, (67 - Long.numberOfLeadingZeros(v)) / 4);
+        buf[pos++] = '0';
+        buf[pos++] = 'x';
+        for (int shift = (digits - 1) * 4; shift >= 0; shift -= 4)
+            buf[pos++] = HEX[(int) (v >>> shift) & 15];
+    }
+
+    private void bytes(byte[] b)
+    {
+        System.arraycopy(b, 0, buf, pos, b.length);
+        pos += b.length;
+    }
+}
@@ -0,0 +1,116 @@
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    Adaptive Replacement Cache (ARC, Megiddo & Modha). Resident pages are split
+    between T1 (seen once recently) and T2 (seen at least twice); B1 & B2 remember
+    the pages most recently evicted from each (page numbers only, no frames). A
+    fault on a page in B1 means T1 was too small, so its target size p grows; one
+    in B2 shrinks it. Every list is in LRU order (oldest first) & all four share
+    one index, so each access is O(1).
+ */
+class Arc extends Simulator
+{
+    private static final int T1 = 0, T2 = 1, B1 = 2, B2 = 3;
+
+    private final PageIndex<Node> index;   // Page # -> node, resident or ghost
+    private final Node[] lists = new Node[4];
+    private final int[]  size = new int[4];
+    private int p = 0; // Target size of T1
+
+    Arc(int frames)
+    {
+        super(frames);
+        index = new PageIndex<Node>(2 * frames);
+        for (int i = 0; i < 4; i++) lists[i] = Node.list();
+    }
+
+    void access(long address, boolean write)
+    {
+        long page = address >> pageShift;
+        Node x = index.get(page);
+
+        if (x != null && (x.where == T1 || x.where == T2)) // Hit, now used twice
+        {
+            hit(address);
+            if(write) x.dirty = true;
+            move(x, T2);
+            return;
+        }
+
+        if (x != null) // Ghost hit: adapt p, make room, bring it back into T2
+        {
+            if (x.where == B1) p = Math.min(frames, p + Math.max(size[B2] / size[B1], 1));
+            else p = Math.max(0, p - Math.max(size[B1] / size[B2], 1));
+            replace(address, x.where == B2);
+            x.dirty = write;
+            move(x, T2);
+            return;
+        }
+
+        // Not seen recently at all
+        int l1 = size[T1] + size[B1], total = l1 + size[T2] + size[B2];
+        if (l1 == frames)
+        {
+            if (size[T1] < frames) // Forget the oldest B1 page, reuse its node
+            {
+                x = drop(B1);
+                replace(address, false);
+            }
+            else // B1 is empty, evict the oldest T1 page without remembering it
+            {
+                x = lists[T1].next;
+                evict(address, x);
+                x = drop(T1);
+            }
+        }
+        else if (total >= frames)
+        {
+            if (total == 2 * frames) x = drop(B2);
+            replace(address, false);
+        }
+        else fault(address);
+
+        if (x == null) x = new Node(page, write);
+        x.page = page;
+        x.dirty = write;
+        index.put(page, x);
+        x.where = T1;
+        Node.append(lists[T1], x);
+        size[T1]++;
+    }
+
+    /*
+        Frees a frame: evicts the oldest page of T1 into B1 if T1 is over its target
+        (or at it, when the faulting page came from B2), else the oldest of T2 into B2.
+    */
+    private void replace(long address, boolean inB2)
+    {
+        int  from = size[T1] > 0 && (size[T1] > p || (inB2 && size[T1] == p)) ? T1 : T2;
+        Node victim = lists[from].next;
+
+        evict(address, victim);
+        victim.dirty = false;
+        move(victim, from == T1 ? B1 : B2);
+    }
+
+    // Moves n to the most recently used end of list to
+    private void move(Node n, int to)
+    {
+        Node.unlink(n);
+        size[n.where]--;
+        Node.append(lists[to], n);
+        size[to]++;
+        n.where = to;
+    }
+
+    // Takes the oldest node off a list & out of the index, for reuse
+    private Node drop(int from)
+    {
+        Node n = lists[from].next;
+        Node.unlink(n);
+        size[from]--;
+        index.remove(n.page);
+        return n;
+    }
+}
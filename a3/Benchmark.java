@@ -0,0 +1,139 @@
+import java.io.*;
+import java.util.*;
+
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    Regression benchmark (vmsim -b): every algorithm at several frame counts on a
+    fixed set of synthetic workloads (TraceGen specs with fixed seeds), plus
+    swim.trace.gz if it is in the current directory. One CSV row per run:
+        workload,algorithm,frames,accesses,faults,writes,fault_rate,accesses_per_s
+    Given a baseline file that doesn't exist yet, the rows are saved to it as the
+    baseline. Given one that does, every row is checked against it: the workloads
+    are deterministic, so different faults or writes mean an algorithm changed, and
+    throughput under TOLERANCE of the baseline's is reported as slower. Runs go one
+    at a time so the timings don't compete for cores, after one untimed pass over
+    the first workload to warm up the JIT.
+ */
+class Benchmark
+{
+    static final String[] ALGORITHMS = {"opt", "lru", "clock", "wsclock", "fifo", "nru", "arc", "2q", "lfu"};
+    static final int[]    FRAMES = {64, 256, 1024, 4096};
+    static final int      REFRESH = 1000;   // NRU's refresh, WSClock's window is the frames
+    static final double   TOLERANCE = 0.8;  // Slower if under this share of the baseline's accesses/s
+
+    static final String[][] WORKLOADS =
+    {
+        {"uniform", "gen:uniform:pages=8192"},
+        {"zipf",    "gen:zipf:pages=65536,s=0.99"},
+        {"hotset",  "gen:hot:pages=65536,hot=2048,p=0.9"},
+        {"scan",    "gen:seq:run=8"},
+        {"loop",    "gen:loop:pages=2048,run=4"},
+        {"phases",  "gen:zipf:pages=16384,n=300000+loop:pages=1536,n=300000+uniform:pages=4096,n=400000"},
+    };
+
+    private static final String HEADER = "workload,algorithm,frames,accesses,faults,writes,fault_rate,accesses_per_s";
+
+    /**
+        Runs the suite, printing the rows as they finish, then saves or checks the
+        baseline.
+        @param baseline Baseline CSV file, null to only print the rows
+    */
+    static void run(String baseline)
+    {
+        List<String[]> workloads = new ArrayList<String[]>(Arrays.asList(WORKLOADS));
+        Map<String, String[]> base = baseline != null ? load(baseline) : null;
+        StringBuilder rows = new StringBuilder(HEADER).append('\n');
+        List<String>  changed = new ArrayList<String>(), slower = new ArrayList<String>();
+
+        if (new File("swim.trace.gz").exists()) workloads.add(new String[] {"swim", "swim.trace.gz"});
+        System.out.println(HEADER);
+        for (int w = 0; w < workloads.size(); w++)
+        {
+            Trace trace = Trace.read(workloads.get(w)[1]);
+            trace.nextUse(12); // Shared by the OPT runs, so none of them pays for it
+            if (w == 0)
+                for (String name : ALGORITHMS) simulate(trace, name, FRAMES[0]);
+
+            for (String name : ALGORITHMS)
+                for (int f : FRAMES)
+                {
+                    long      start = System.nanoTime();
+                    Simulator sim = simulate(trace, name, f);
+                    double    seconds = (System.nanoTime() - start) / 1e9;
+                    String    key = workloads.get(w)[0] + "," + name + "," + f;
+                    String    row = String.format(Locale.ROOT, "%s,%d,%d,%d,%.6f,%.0f", key, sim.maccesses,
+                        sim.faults, sim.writes, (double) sim.faults / sim.maccesses, sim.maccesses / seconds);
+                    System.out.println(row);
+                    rows.append(row).append('\n');
+
+                    String[] old = base != null ? base.get(key) : null;
+                    if (old == null) continue;
+                    if (!old[4].equals("" + sim.faults) || !old[5].equals("" + sim.writes))
+                        changed.add(String.format("%s: faults %s -> %d, writes %s -> %d", key, old[4],
+                            sim.faults, old[5], sim.writes));
+                    if (sim.maccesses / seconds < TOLERANCE * Double.parseDouble(old[7]))
+                        slower.add(String.format("%s: %s -> %.0f accesses/s", key, old[7],
+                            sim.maccesses / seconds));
+                }
+        }
+
+        if (baseline == null) return;
+        if (base == null)
+        {
+            save(baseline, rows.toString());
+            System.err.println("Baseline saved to " + baseline);
+            return;
+        }
+        for (String c : changed) System.err.println("Changed: " + c);
+        for (String s : slower) System.err.println("Slower:  " + s);
+        System.err.printf("Compared with %s: %d changed, %d slower\n", baseline, changed.size(), slower.size());
+    }
+
+    private static Simulator simulate(Trace trace, String name, int frames)
+    {
+        Simulator sim = Simulator.create(name, frames, "refresh".equals(Simulator.paramName(name)) ? REFRESH : 0);
+        sim.run(trace);
+        return sim;
+    }
+
+    // Rows of a baseline by "workload,algorithm,frames", null if there's no file yet
+    private static Map<String, String[]> load(String fileName)
+    {
+        if (!new File(fileName).exists()) return null;
+        Map<String, String[]> rows = new HashMap<String, String[]>();
+        try
+        {
+            BufferedReader in = new BufferedReader(new FileReader(fileName));
+            String line = in.readLine(); // Header
+            while ((line = in.readLine()) != null)
+            {
+                String[] f = line.split(",");
+                if (f.length == 8) rows.put(f[0] + "," + f[1] + "," + f[2], f);
+            }
+            in.close();
+        }
+        catch (IOException e)
+        {
+            System.out.println("Error opening file. Exiting.");
+            System.exit(0);
+        }
+        return rows;
+    }
+
+    private static void save(String fileName, String rows)
+    {
+        try
+        {
+            Writer out = new FileWriter(fileName);
+            out.write(rows);
+            out.close();
+        }
+        catch (IOException e)
+        {
+            System.out.println("Error writing file. Exiting.");
+            System.exit(0);
+        }
+    }
+}
@@ -0,0 +1,102 @@
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    Clock algorithm. Frames form a circular list. On fault, the hand moves around
+    it clearing referenced bits until it finds an unreferenced page to evict.
+ */
+class Clock extends Simulator
+{
+    private final PageIndex<Node> index; // Page # -> frame
+    private Node hand, tail;             // tail.next is the first frame added
+    private int  listLen = 0;
+
+    Clock(int frames)
+    {
+        super(frames);
+        index = new PageIndex<Node>(frames);
+    }
+
+    void access(long address, boolean write)
+    {
+        long page = address >> pageShift;
+        Node temp = index.get(page);
+
+        if (temp != null) // Update referenced & dirty (if necessary)
+        {
+            hit(address);
+            temp.referenced = true;
+            if(write) temp.dirty = true;
+            return;
+        }
+
+        if (listLen < frames) // PT is not full, add the page after the last frame
+        {
+            fault(address);
+            listLen++;
+            temp = new Node(page, write);
+            if (tail == null) hand = temp.next = temp;
+            else
+            {
+                temp.next = tail.next;
+                tail.next = temp;
+            }
+            tail = temp;
+            index.put(page, temp);
+            return;
+        }
+
+        // Look for the next unreferenced page, marking referenced pages as
+        // unreferenced until one is found.
+        while (hand.referenced)
+        {
+            hand.referenced = false;
+            hand = hand.next;
+        }
+        evict(address, hand);
+        index.remove(hand.page);
+        hand.page = page;
+        index.put(page, hand);
+        hand.referenced = true;
+        hand.dirty = write;
+    }
+
+    // From the hand around to the frame before it
+    Node upcoming(Node n)
+    {
+        if (n == null) return hand;
+        return n.next == hand ? null : n.next;
+    }
+
+    Node resident(long page)
+    {
+        return index.get(page);
+    }
+
+    boolean release()
+    {
+        Node victim = null;
+        if (listLen == frames && listLen > 0) // Full, give up the page the hand picks
+        {
+            while (hand.referenced)
+            {
+                hand.referenced = false;
+                hand = hand.next;
+            }
+            victim = hand;
+            Node prev = hand;
+            while (prev.next != victim) prev = prev.next; // Singly linked, walk around
+            if (prev == victim) hand = tail = null;       // It was the only frame
+            else
+            {
+                prev.next = victim.next;
+                if (tail == victim) tail = prev;
+                hand = victim.next;
+            }
+            index.remove(victim.page);
+            listLen--;
+        }
+        released(victim);
+        return true;
+    }
+}
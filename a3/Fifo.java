@@ -0,0 +1,78 @@
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    First-in-first-out (FIFO) algorithm. On fault, evicts the oldest entry in the PT.
+ */
+class Fifo extends Simulator
+{
+    private final PageIndex<Node> index; // Page # -> frame
+    private Node head, tail;             // Oldest & newest frames
+    private int  listLen = 0;
+
+    Fifo(int frames)
+    {
+        super(frames);
+        index = new PageIndex<Node>(frames);
+    }
+
+    void access(long address, boolean write)
+    {
+        long page = address >> pageShift;
+        Node temp = index.get(page);
+
+        if (temp != null)
+        {
+            hit(address);
+            temp.referenced = true;
+            if(write) temp.dirty = true;
+            return;
+        }
+
+        if (listLen < frames) // PT is not full, add page to the end
+        {
+            fault(address);
+            listLen++;
+            temp = new Node(page, write);
+            if (head == null) head = temp;
+            else tail.next = temp;
+            tail = temp;
+            index.put(page, temp);
+            return;
+        }
+
+        // Evict the oldest PTE, its frame becomes the newest
+        evict(address, head);
+        index.remove(head.page);
+        tail.next = head; tail = head; head = head.next; tail.next = null;
+        tail.page = page; tail.referenced = true;
+        index.put(page, tail);
+        tail.dirty = write;
+    }
+
+    // Oldest first
+    Node upcoming(Node n)
+    {
+        return n == null ? head : n.next;
+    }
+
+    Node resident(long page)
+    {
+        return index.get(page);
+    }
+
+    boolean release()
+    {
+        Node victim = null;
+        if (listLen == frames && listLen > 0) // Full, give up the oldest
+        {
+            victim = head;
+            head = head.next;
+            if (head == null) tail = null;
+            index.remove(victim.page);
+            listLen--;
+        }
+        released(victim);
+        return true;
+    }
+}
@@ -0,0 +1,129 @@
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    Dirty page write-back model, run next to the replacement policy.
+        disk        one queue, an I/O of k pages takes access + k * perPage us.
+                    Faults are synchronous: the process waits for the disk to be
+                    free, then for the dirty victim's write (a foreground, stall
+                    write) & the read of the new page. Each access between costs
+                    cpu us of virtual time, when the disk can catch up.
+        flusher     every `every` accesses, looks at the next `ahead` frames the
+                    policy will evict (from the clock hand, FIFO head or LRU end)
+                    & cleans up to `pages` of the dirty ones in the background,
+                    queued on the disk without stalling the process. With a
+                    threshold it only runs while at least that fraction of those
+                    frames is dirty. pages = 0 is the disk model alone.
+        coalescing  a background write takes the resident dirty pages next to
+                    the one picked along, up to coalesce pages in one I/O.
+    Foreground writes stay in the simulator's writes; background ones are counted
+    here. Background writes avoid stalls but can queue ahead of faults (reported
+    as time spent waiting behind the flusher).
+ */
+class Flusher
+{
+    private final Simulator sim;
+    private final int    every, pages, ahead, coalesce;
+    private final double threshold, accessUs, pageUs, cpuUs;
+    private int tick = 0;
+
+    double now = 0, diskFree = 0;   // Virtual time & when the disk is done with its queue, us
+    double writeStall = 0,          // Waiting for foreground writes
+           queueStall = 0,          // Waiting for background writes ahead in the queue
+           stall = 0;               // All the time spent waiting on the disk
+    long   ios = 0, written = 0;    // Background writes & the pages they wrote
+
+    /**
+        @param every Accesses between runs of the flusher
+        @param pages Most pages cleaned in a run, 0 for no flusher
+        @param ahead Frames looked at from the eviction point, 0 for a quarter of them
+        @param threshold Fraction of those that must be dirty for the flusher to run
+        @param coalesce Most pages in one background write
+        @param accessUs Time for the disk to start an I/O (seek & rotation), us
+        @param pageUs Time to transfer a page, us
+        @param cpuUs Time between accesses, us
+    */
+    Flusher(Simulator sim, int every, int pages, int ahead, double threshold, int coalesce,
+        double accessUs, double pageUs, double cpuUs)
+    {
+        this.sim = sim;
+        this.every = Math.max(1, every);
+        this.pages = pages;
+        this.ahead = ahead > 0 ? ahead : Math.max(pages, sim.frames / 4);
+        this.threshold = threshold;
+        this.coalesce = Math.max(1, coalesce);
+        this.accessUs = accessUs;
+        this.pageUs = pageUs;
+        this.cpuUs = cpuUs;
+    }
+
+    // After every access
+    void access()
+    {
+        now += cpuUs;
+        if (++tick < every) return;
+        tick = 0;
+        if (pages > 0) flush();
+    }
+
+    /**
+        A fault: waits for the disk, writes the victim if it's dirty & reads the page.
+        @param dirty True if the evicted page has to be written first
+    */
+    void fault(boolean dirty)
+    {
+        double start = Math.max(now, diskFree);
+        queueStall += start - now;
+        if (dirty) writeStall += accessUs + pageUs;
+        diskFree = start + (dirty ? 2 : 1) * (accessUs + pageUs);
+        stall += diskFree - now;
+        now = diskFree;
+    }
+
+    private void flush()
+    {
+        int  seen = 0, dirty = 0, cleaned = 0;
+        Node n;
+
+        if (threshold > 0)
+        {
+            for (n = sim.upcoming(null); n != null && seen < ahead; n = sim.upcoming(n), seen++)
+                if (n.dirty) dirty++;
+            if (dirty < threshold * seen) return;
+            seen = 0;
+        }
+        for (n = sim.upcoming(null); n != null && seen < ahead && cleaned < pages; n = sim.upcoming(n), seen++)
+            if (n.dirty) cleaned += write(n);
+    }
+
+    // Writes n & the dirty resident pages around it in one I/O, returns the pages
+    private int write(Node n)
+    {
+        long lo = n.page, hi = n.page;
+        Node m;
+
+        while (hi - lo + 1 < coalesce && (m = sim.resident(hi + 1)) != null && m.dirty) hi++;
+        while (hi - lo + 1 < coalesce && (m = sim.resident(lo - 1)) != null && m.dirty) lo--;
+        for (long p = lo; p <= hi; p++)
+            if ((m = sim.resident(p)) != null) m.dirty = false;
+        n.dirty = false;
+
+        int k = (int) (hi - lo + 1);
+        diskFree = Math.max(diskFree, now) + accessUs + k * pageUs;
+        ios++;
+        written += k;
+        return k;
+    }
+
+    void report()
+    {
+        System.out.printf("Foreground writes:\t%,9d\n", sim.writes);
+        System.out.printf("Background writes:\t%,9d (%,d I/Os)\n", written, ios);
+        System.out.printf("Write stall (s):  \t%,9.3f\n", writeStall / 1e6);
+        System.out.printf("Flusher queue wait (s):\t%,9.3f\n", queueStall / 1e6);
+        System.out.printf("Total disk stall (s):\t%,9.3f\n", stall / 1e6);
+        System.out.printf("Virtual run time (s):\t%,9.3f\n", now / 1e6);
+        if (sim.faults > 0)
+            System.out.printf("Average fault (ms):\t%,9.3f\n", stall / sim.faults / 1e3);
+    }
+}
@@ -0,0 +1,74 @@
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    Least-Frequently-Used (LFU) algorithm. Evicts the page used the fewest times
+    since it was brought in, the least recently used one on a tie. Pages are kept in
+    one list per use count (oldest first), and the smallest count with a page in it
+    is tracked, so each access is O(1): a hit only moves its page to the next list.
+ */
+class Lfu extends Simulator
+{
+    private final PageIndex<Node> index;   // Page # -> frame
+    private final PageIndex<Node> byUses;  // Use count -> list of frames (sentinel)
+    private int listLen = 0, minUses = 0;  // Smallest use count of a resident page
+
+    Lfu(int frames)
+    {
+        super(frames);
+        index = new PageIndex<Node>(frames);
+        byUses = new PageIndex<Node>(64);
+    }
+
+    void access(long address, boolean write)
+    {
+        long page = address >> pageShift;
+        Node temp = index.get(page);
+
+        if (temp != null)
+        {
+            hit(address);
+            if(write) temp.dirty = true;
+            remove(temp);
+            if (minUses == temp.uses && byUses.get(minUses) == null) minUses++;
+            temp.uses++;
+            add(temp);
+            return;
+        }
+
+        if (listLen < frames) // PT is not full
+        {
+            fault(address);
+            listLen++;
+            temp = new Node(page, write);
+        }
+        else // Evict the oldest of the least used pages & reuse its frame
+        {
+            temp = byUses.get(minUses).next;
+            evict(address, temp);
+            remove(temp);
+            index.remove(temp.page);
+            temp.page = page;
+            temp.dirty = write;
+        }
+        temp.uses = minUses = 1;
+        index.put(page, temp);
+        add(temp);
+    }
+
+    // Adds n to the end of the list for its use count
+    private void add(Node n)
+    {
+        Node list = byUses.get(n.uses);
+        if (list == null) byUses.put(n.uses, list = Node.list());
+        Node.append(list, n);
+    }
+
+    // Takes n off its use count's list, dropping the list if that empties it
+    private void remove(Node n)
+    {
+        Node.unlink(n);
+        Node list = byUses.get(n.uses);
+        if (Node.isEmpty(list)) byUses.remove(n.uses);
+    }
+}
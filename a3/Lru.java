@@ -0,0 +1,78 @@
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    Least-Recently-Used (LRU) algorithm. Frames are kept in order of last use, a
+    hit moves its frame to the end, so the victim is always the first frame.
+ */
+class Lru extends Simulator
+{
+    private final PageIndex<Node> index; // Page # -> frame
+    private final Node frameList = Node.list(); // Least to most recently used
+    private int listLen = 0;
+
+    Lru(int frames)
+    {
+        super(frames);
+        index = new PageIndex<Node>(frames);
+    }
+
+    void access(long address, boolean write)
+    {
+        long page = address >> pageShift;
+        Node temp = index.get(page);
+
+        if (temp != null) // Now the most recently used
+        {
+            hit(address);
+            if(write) temp.dirty = true;
+            Node.unlink(temp);
+            Node.append(frameList, temp);
+            return;
+        }
+
+        if (listLen < frames) // PT is not full
+        {
+            fault(address);
+            listLen++;
+            temp = new Node(page, write);
+        }
+        else // Evict the least recently used page & reuse its frame
+        {
+            temp = frameList.next;
+            evict(address, temp);
+            Node.unlink(temp);
+            index.remove(temp.page);
+            temp.page = page;
+            temp.dirty = write;
+        }
+        index.put(page, temp);
+        Node.append(frameList, temp);
+    }
+
+    // Least recently used first
+    Node upcoming(Node n)
+    {
+        Node next = n == null ? frameList.next : n.next;
+        return next == frameList ? null : next;
+    }
+
+    Node resident(long page)
+    {
+        return index.get(page);
+    }
+
+    boolean release()
+    {
+        Node victim = null;
+        if (listLen == frames && listLen > 0) // Full, give up the least recently used
+        {
+            victim = frameList.next;
+            Node.unlink(victim);
+            index.remove(victim.page);
+            listLen--;
+        }
+        released(victim);
+        return true;
+    }
+}
@@ -0,0 +1,155 @@
+import java.io.*;
+
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    Time series of a run: one row every K accesses with
+        window, end       window number & accesses so far
+        faults, writes    page faults & dirty pages written in the window
+        distinct          distinct pages touched in the window
+        ws_<tau>...       working set size W(t, tau) at the end of the window: the
+                          distinct pages touched in the last tau accesses
+    Rows go to a CSV file, or a binary one (8 byte big endian longs per row after a
+    header of the column count & names) if the name ends in .bin.
+    W is kept up to date on every access for all the taus at once: a page enters
+    when it's touched after more than tau accesses & leaves when its last access
+    is tau accesses old, found with a ring of the last max(tau, k) accesses. A
+    page whose last access falls off the end of the ring is out of every working
+    set & the current window, so its record is dropped: memory is bounded by the
+    ring, however many distinct pages the trace touches.
+ */
+class Metrics
+{
+    private final Simulator sim;
+    private final int       k;        // Accesses per window
+    private final int[]     taus;
+    private final int[]     ws;       // W(t, tau) for each tau
+    private final PageIndex<long[]> pages = new PageIndex<long[]>(1024);
+    private final long[][]  ring;     // Page record of each of the last max(tau, k) accesses
+    private long t = 0, window = 0, faults = 0, writes = 0;
+    private int  distinct = 0;
+
+    private final boolean          binary;
+    private final DataOutputStream out;
+
+    /**
+        @param sim Simulator whose faults & writes are reported
+        @param k Accesses per window
+        @param taus Working set windows, in accesses
+        @param fileName Where the rows go, .bin for binary
+    */
+    Metrics(Simulator sim, int k, int[] taus, String fileName)
+    {
+        int ringSize = k + 1;
+        for (int tau : taus) ringSize = Math.max(ringSize, tau + 1);
+
+        this.sim = sim;
+        this.k = k;
+        this.taus = taus;
+        ws = new int[taus.length];
+        ring = new long[ringSize][];
+        binary = fileName.endsWith(".bin");
+
+        DataOutputStream o = null;
+        try
+        {
+            o = new DataOutputStream(new BufferedOutputStream(new FileOutputStream(fileName), 1 << 16));
+            String[] columns = new String[5 + taus.length];
+            String[] fixed = {"window", "end", "faults", "writes", "distinct"};
+            System.arraycopy(fixed, 0, columns, 0, 5);
+            for (int i = 0; i < taus.length; i++) columns[5 + i] = "ws_" + taus[i];
+            if (binary)
+            {
+                o.writeInt(columns.length);
+                for (String c : columns) o.writeUTF(c);
+            }
+            else o.writeBytes(String.join(",", columns) + "\n");
+        }
+        catch (IOException e)
+        {
+            System.out.println("Error opening file. Exiting.");
+            System.exit(0);
+        }
+        out = o;
+    }
+
+    /**
+        Counts an access to page; call after the simulator has handled it.
+    */
+    void access(long page)
+    {
+        // The access leaving the ring: if it was its page's last, forget the page
+        int    slot = (int) (t % ring.length);
+        long[] oldest = ring[slot];
+        if (oldest != null && oldest[0] == t - ring.length) pages.remove(oldest[2]);
+
+        // rec: {last access, last window touched, page}
+        long[] rec = pages.get(page);
+        long   last = Long.MIN_VALUE;
+        if (rec == null) pages.put(page, rec = new long[] {-1, -1, page});
+        else last = rec[0];
+
+        for (int i = 0; i < taus.length; i++)
+        {
+            long old = t - taus[i]; // Access leaving the window (t - tau, t]
+            if (old >= 0)
+            {
+                long[] gone = ring[(int) (old % ring.length)];
+                if (gone[0] == old) ws[i]--; // That was its page's last access
+            }
+            if (last <= old) ws[i]++; // Not touched in the window until now
+        }
+        rec[0] = t;
+        ring[slot] = rec;
+
+        if (rec[1] != window)
+        {
+            rec[1] = window;
+            distinct++;
+        }
+        if (++t % k == 0) row();
+    }
+
+    /**
+        Writes the last (partial) window & closes the file.
+    */
+    void finish()
+    {
+        if (t % k != 0) row();
+        try { out.close(); }
+        catch (IOException e) {}
+    }
+
+    private void row()
+    {
+        long[] v = new long[5 + taus.length];
+        v[0] = window;
+        v[1] = t;
+        v[2] = sim.faults - faults;
+        v[3] = sim.writes - writes;
+        v[4] = distinct;
+        for (int i = 0; i < taus.length; i++) v[5 + i] = ws[i];
+
+        try
+        {
+            if (binary) for (long x : v) out.writeLong(x);
+            else
+            {
+                StringBuilder line = new StringBuilder();
+                for (int i = 0; i < v.length; i++) line.append(i == 0 ? "" : ",").append(v[i]);
+                out.writeBytes(line.append('\n').toString());
+            }
+        }
+        catch (IOException e)
+        {
+            System.out.println("Error writing file. Exiting.");
+            System.exit(0);
+        }
+
+        window++;
+        faults = sim.faults;
+        writes = sim.writes;
+        distinct = 0;
+    }
+}
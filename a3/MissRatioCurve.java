@@ -0,0 +1,235 @@
+import java.util.Arrays;
+
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    Faults & dirty writes of LRU and OPT for every frame count 1..N from one pass
+    over the trace (stack distance analysis), printed as CSV.
+
+    Both algorithms have the inclusion property: the pages held with F frames are
+    the top F of a "stack", so an access faults with F frames exactly when its page
+    is deeper than F (its stack distance). Counting distances gives every F at once.
+        LRU: the stack is recency order. The distance is 1 + the number of distinct
+             pages touched since the page's last access, counted with a Fenwick tree
+             over access times (a 1 marks each page's latest access), O(log n).
+        OPT: Mattson's priority stack. The referenced page goes on top & the page it
+             displaces is carried down; at each level the carried page swaps with the
+             one there if that one is used again later. Only the top N levels matter,
+             whatever is carried past N is dropped, so an access costs O(min(depth, N)).
+
+    Dirty writes: a page evicted with F frames is written if it was written since it
+    was last brought in with F frames, i.e. every access after its last write had a
+    distance <= F. With M = the largest distance since the last write, the eviction
+    is a write for F >= M. Evictions & writes each cover a range of F, which are
+    added to a difference array.
+ */
+class MissRatioCurve
+{
+    private int    n, pages;     // Accesses & distinct pages in the trace
+    private int[]  ids;          // Page of every access, numbered 0..pages-1
+    private boolean[] writes;    // True for every access that is a write
+    private final int maxFrames; // N
+    private final int pageShift; // log2 of the page size
+
+    private MissRatioCurve(int maxFrames, int pageShift)
+    {
+        this.maxFrames = maxFrames;
+        this.pageShift = pageShift;
+    }
+
+    /**
+        Prints frames,lru_faults,lru_writes,opt_faults,opt_writes for 1..maxFrames.
+        @param fileName String of the trace file's name.
+        @param maxFrames Largest frame count (N)
+        @param pageShift log2 of the page size
+    */
+    static void run(String fileName, int maxFrames, int pageShift)
+    {
+        MissRatioCurve mrc = new MissRatioCurve(maxFrames, pageShift);
+        mrc.read(fileName);
+
+        long[] lruFaults = new long[maxFrames + 2], lruWrites = new long[maxFrames + 2];
+        long[] optFaults = new long[maxFrames + 2], optWrites = new long[maxFrames + 2];
+        mrc.lru(lruFaults, lruWrites);
+        mrc.opt(optFaults, optWrites);
+
+        StringBuilder out = new StringBuilder("frames,lru_faults,lru_writes,opt_faults,opt_writes\n");
+        for (int f = 1; f <= maxFrames; f++)
+            out.append(f).append(',').append(lruFaults[f]).append(',').append(lruWrites[f])
+               .append(',').append(optFaults[f]).append(',').append(optWrites[f]).append('\n');
+        System.out.print(out);
+    }
+
+    // Reads the trace, numbering the pages as they first show up
+    private void read(String fileName)
+    {
+        Trace trace = Trace.read(fileName);
+        PageIndex<int[]> number = new PageIndex<int[]>(1024);
+
+        n = trace.n;
+        ids = new int[n];
+        writes = trace.write;
+        for (int i = 0; i < n; i++)
+        {
+            int[] id = number.get(trace.address[i] >> pageShift);
+            if (id == null) number.put(trace.address[i] >> pageShift, id = new int[] {pages++});
+            ids[i] = id[0];
+        }
+    }
+
+    /*
+        Per page write state for the dirty write ranges. maxSince[p] is M, the largest
+        distance since p's last write, or NO_WRITE if p hasn't been written.
+    */
+    private static final int NO_WRITE = Integer.MAX_VALUE;
+
+    // p is evicted for every F in [lo, hi]; counts the F's where it is dirty
+    private void evicted(int[] maxSince, long[] diff, int p, int lo, int hi)
+    {
+        lo = Math.max(lo, maxSince[p]);
+        if (maxSince[p] == NO_WRITE || lo > hi) return;
+        diff[lo]++;
+        diff[hi + 1]--;
+    }
+
+    // Records access i (distance d) in p's write state
+    private void accessed(int[] maxSince, int i, int p, int d)
+    {
+        if (writes[i]) maxSince[p] = 1;
+        else if (maxSince[p] != NO_WRITE) maxSince[p] = Math.max(maxSince[p], d);
+    }
+
+    /*
+        Turns counts of accesses per distance (maxFrames + 1 = deeper / never seen)
+        into faults per frame count, & the write difference array into writes.
+    */
+    private void finish(long[] faults, long[] hist, long[] writeDiff)
+    {
+        long misses = hist[maxFrames + 1], w = 0;
+        for (int f = maxFrames; f >= 1; f--) // Faults with f frames: distance > f
+        {
+            faults[f] = misses;
+            misses += hist[f];
+        }
+        for (int f = 1; f <= maxFrames; f++)
+        {
+            w += writeDiff[f];
+            writeDiff[f] = w;
+        }
+    }
+
+    private void lru(long[] faults, long[] writeCounts)
+    {
+        int[]  last = new int[pages], maxSince = new int[pages];
+        int[]  tree = new int[n + 1]; // Fenwick tree over access times, 1 based
+        long[] hist = new long[maxFrames + 2];
+        int    cap = maxFrames + 1;
+
+        Arrays.fill(last, -1);
+        Arrays.fill(maxSince, NO_WRITE);
+        for (int i = 0; i < n; i++)
+        {
+            int p = ids[i], d = cap;
+            if (last[p] >= 0)
+            {
+                // Distinct pages touched in (last, i), plus p itself
+                d = (int) Math.min(cap, 1 + sum(tree, i) - sum(tree, last[p] + 1));
+                add(tree, last[p] + 1, -1);
+
+                // p was evicted for every F < d since its last access
+                evicted(maxSince, writeCounts, p, 1, Math.min(d - 1, maxFrames));
+            }
+            hist[d]++;
+            add(tree, i + 1, 1);
+            last[p] = i;
+            accessed(maxSince, i, p, d);
+        }
+
+        // Pages still in memory at the end aren't written; the rest were evicted for
+        // F < 1 + the pages touched after them
+        for (int p = 0; p < pages; p++)
+        {
+            long d = 1 + sum(tree, n) - sum(tree, last[p] + 1);
+            evicted(maxSince, writeCounts, p, 1, (int) Math.min(d - 1, maxFrames));
+        }
+        finish(faults, hist, writeCounts);
+    }
+
+    private void opt(long[] faults, long[] writeCounts)
+    {
+        int[]  nextUse = new int[n], next = new int[pages];
+        int[]  stack = new int[maxFrames + 1], depth = new int[pages], maxSince = new int[pages];
+        long[] hist = new long[maxFrames + 2];
+        int    size = 0;
+
+        // nextUse[i] is the next access to i's page, n if there isn't one
+        Arrays.fill(next, n);
+        for (int i = n - 1; i >= 0; i--)
+        {
+            nextUse[i] = next[ids[i]];
+            next[ids[i]] = i;
+        }
+        // next[p] is now p's first use; from here on it is p's next use after the current access
+
+        Arrays.fill(maxSince, NO_WRITE);
+        for (int i = 0; i < n; i++)
+        {
+            int p = ids[i], d = depth[p] > 0 ? depth[p] : maxFrames + 1;
+            hist[d]++;
+            next[p] = nextUse[i];
+
+            if (d > 1)
+            {
+                // p goes on top, the old top is carried down; at each level the page
+                // used later is the one carried on. Evicted with F frames: whatever is
+                // carried from level F to F + 1.
+                int end = d <= maxFrames ? d : Math.min(size + 1, maxFrames + 1);
+                int carried = stack[1], from = 1;
+                stack[1] = p;
+                depth[p] = 1;
+                for (int j = 2; j < end; j++)
+                {
+                    int here = stack[j];
+                    if (next[here] > next[carried])
+                    {
+                        evicted(maxSince, writeCounts, carried, from, j - 1);
+                        stack[j] = carried;
+                        depth[carried] = j;
+                        carried = here;
+                        from = j;
+                    }
+                }
+                if (size == 0) end = 0; // Nothing was carried
+                if (end > 0 && end <= maxFrames) // Fills p's old level or a new one
+                {
+                    evicted(maxSince, writeCounts, carried, from, Math.min(end - 1, size));
+                    stack[end] = carried;
+                    depth[carried] = end;
+                }
+                else if (end > 0) // Carried off the bottom, evicted for every F left
+                {
+                    evicted(maxSince, writeCounts, carried, from, maxFrames);
+                    depth[carried] = 0;
+                }
+                if (d > maxFrames && size < maxFrames) size++;
+            }
+            accessed(maxSince, i, p, d);
+        }
+        finish(faults, hist, writeCounts);
+    }
+
+    // Fenwick tree: sum of [1, i] (Shards.mrc() uses these too)
+    static long sum(int[] tree, int i)
+    {
+        long s = 0;
+        for (; i > 0; i -= i & -i) s += tree[i];
+        return s;
+    }
+
+    // Fenwick tree: adds v at i (1 based)
+    static void add(int[] tree, int i, int v)
+    {
+        for (; i < tree.length; i += i & -i) tree[i] += v;
+    }
+}
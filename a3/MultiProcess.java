@@ -0,0 +1,212 @@
+import java.util.Arrays;
+
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    Replays several traces at once, one process per trace (pid = its position on
+    the command line). Accesses are interleaved round robin (quantum accesses per
+    turn) or by timestamp (the optional third column of text traces). Every
+    address is tagged with its pid above bit 48, so the page numbers of different
+    processes never collide & still fit one long key of the page index.
+
+    replacement
+        global  one simulator over all the frames, any process's page can be evicted
+        local   one simulator per process, each with its own quota of frames:
+                fixed (given, or the frames split evenly), or adjusted by page fault
+                frequency (PFF): every window accesses of a process, a fault rate
+                above hi takes a frame from the free pool, one below lo gives one back
+ */
+class MultiProcess
+{
+    static final int PID_SHIFT = 48; // Tag bits start here, addresses must fit below
+
+    private final String[] files;
+    private final Trace    trace;    // Merged, tagged
+    private final long[]   accesses, faults, writes; // Per process
+    private final int[]    quota;    // Per process frames at the end, local only
+
+    /**
+        Reads & merges the traces.
+        @param files One trace per process
+        @param interleave "rr", "rr:<quantum>" or "time"
+    */
+    MultiProcess(String[] files, String interleave)
+    {
+        this.files = files;
+        accesses = new long[files.length];
+        faults = new long[files.length];
+        writes = new long[files.length];
+        quota = new int[files.length];
+        trace = merge(files, interleave);
+        for (int i = 0; i < trace.n; i++) accesses[pid(trace.address[i])]++;
+    }
+
+    static int pid(long address)
+    {
+        return (int) (address >>> PID_SHIFT);
+    }
+
+    private static Trace merge(String[] files, String interleave)
+    {
+        int           k = files.length, n = 0, quantum = 1, left = 0;
+        boolean       byTime = interleave.equals("time");
+        TraceReader[] tr = new TraceReader[k];
+        boolean[]     more = new boolean[k];
+        long[]        address = new long[1 << 16];
+        boolean[]     write = new boolean[address.length];
+
+        if (interleave.startsWith("rr:")) quantum = Integer.parseInt(interleave.substring(3));
+        else if (!byTime && !interleave.equals("rr")) throw new IllegalArgumentException();
+        for (int p = 0; p < k; p++)
+        {
+            tr[p] = TraceReader.open(files[p]);
+            if (more[p] = tr[p].next()) left++;
+            else tr[p].close();
+        }
+
+        for (int p = 0, turn = 0; left > 0; )
+        {
+            if (byTime) // Earliest pending record (ties go to the lower pid)
+            {
+                p = -1;
+                for (int q = 0; q < k; q++)
+                    if (more[q] && (p < 0 || tr[q].time < tr[p].time)) p = q;
+            }
+            else if (!more[p] || turn == quantum) // Next process with records left
+            {
+                do p = (p + 1) % k; while (!more[p]);
+                turn = 0;
+            }
+
+            if (n == address.length)
+            {
+                address = Arrays.copyOf(address, n * 2);
+                write = Arrays.copyOf(write, n * 2);
+            }
+            if (tr[p].address >>> PID_SHIFT != 0) // Would overwrite the pid tag
+            {
+                System.out.println("Error: " + files[p] + " has an address of 2^" + PID_SHIFT
+                    + " or more. Exiting.");
+                System.exit(0);
+            }
+            address[n] = ((long) p << PID_SHIFT) | tr[p].address;
+            write[n++] = tr[p].write;
+            turn++;
+
+            if (!(more[p] = tr[p].next()))
+            {
+                tr[p].close();
+                left--;
+            }
+        }
+        return new Trace(n, address, write);
+    }
+
+    /**
+        Global replacement: sim gets every process's accesses. Faults are charged to
+        the faulting process, writes to the process that owned the dirty page.
+        @param printer Also told about every access, if not null
+    */
+    void runGlobal(Simulator sim, final AccessEvents printer)
+    {
+        final int pageShift = sim.pageShift;
+        sim.events = new AccessEvents()
+        {
+            public void hit(long address)
+            {
+                if (printer != null) printer.hit(address);
+            }
+
+            public void fault(long address)
+            {
+                faults[pid(address)]++;
+                if (printer != null) printer.fault(address);
+            }
+
+            public void evict(long address, boolean dirty, long page)
+            {
+                faults[pid(address)]++;
+                if (dirty) writes[(int) (page >>> (PID_SHIFT - pageShift))]++;
+                if (printer != null) printer.evict(address, dirty, page);
+            }
+        };
+        sim.run(trace);
+    }
+
+    /**
+        Local replacement: sims[p] only sees process p's accesses & frames.
+        With PFF the quotas move: every window accesses of a process, one frame is
+        granted (fault rate > hi & a free frame) or released (fault rate < lo).
+        @param sims One simulator per process, its frames is the starting quota
+        @param free Frames not in any quota (PFF only)
+        @param lo, hi Fault rates per access, both 0 for fixed quotas
+        @param window Accesses of a process between PFF checks
+    */
+    void runLocal(Simulator[] sims, int free, double lo, double hi, int window)
+    {
+        int     k = sims.length;
+        boolean pff = hi > 0;
+        long[]  faultsAt = new long[k]; // Faults as of the last check
+
+        if (!pff) // Processes don't affect each other, run them whole
+        {
+            for (int p = 0; p < k; p++) sims[p].run(only(p));
+        }
+        else
+        {
+            for (int i = 0; i < trace.n; i++)
+            {
+                Simulator sim = sims[pid(trace.address[i])];
+                sim.step(trace.address[i], trace.write[i]);
+                if (sim.maccesses % window != 0) continue;
+
+                int    p = pid(trace.address[i]);
+                double rate = (double) (sim.faults - faultsAt[p]) / window;
+                faultsAt[p] = sim.faults;
+                if (rate > hi && free > 0)
+                {
+                    sim.frames++;
+                    free--;
+                }
+                else if (rate < lo && sim.frames > 1 && sim.release()) free++;
+            }
+        }
+
+        for (int p = 0; p < k; p++)
+        {
+            faults[p] = sims[p].faults;
+            writes[p] = sims[p].writes;
+            quota[p] = sims[p].frames;
+        }
+    }
+
+    // Process p's part of the merged trace
+    private Trace only(int p)
+    {
+        int       n = (int) accesses[p], j = 0;
+        long[]    address = new long[n];
+        boolean[] write = new boolean[n];
+        for (int i = 0; i < trace.n; i++)
+        {
+            if (pid(trace.address[i]) != p) continue;
+            address[j] = trace.address[i];
+            write[j++] = trace.write[i];
+        }
+        return new Trace(n, address, write);
+    }
+
+    /**
+        Prints one line of stats per process.
+        @param local True to show each process's frame quota
+    */
+    void report(boolean local)
+    {
+        System.out.printf("\n%-4s %-20s %12s %10s %10s %9s%s\n", "pid", "trace", "accesses",
+            "faults", "writes", "fault %", local ? "    frames" : "");
+        for (int p = 0; p < files.length; p++)
+            System.out.printf("%-4d %-20s %,12d %,10d %,10d %9.4f%s\n", p, files[p], accesses[p],
+                faults[p], writes[p], accesses[p] == 0 ? 0 : 100.0 * faults[p] / accesses[p],
+                local ? String.format(" %,9d", quota[p]) : "");
+    }
+}
@@ -0,0 +1,68 @@
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    A frame of the page table, linked into whatever list or heap the replacement
+    algorithm keeps its frames in. The static helpers work on circular doubly
+    linked lists with a sentinel node, so adding, removing & moving are O(1).
+ */
+class Node
+{
+    int readNum;  // OPT: when this page is used next (heap key)
+    int heapPos;  // OPT: where this node is in the heap
+    int refEpoch; // NRU: referenced if this is the current epoch
+    int lastUse;  // WSClock: virtual time of the last use seen by the hand
+    int uses;     // LFU: accesses since the page was brought in
+    int where;    // ARC & 2Q: which list the node is on
+    long page;
+    boolean dirty, referenced = true;
+    Node next = null; // Used for traversing as a normal linked list
+    Node prev = null; // Doubly linked lists
+
+    Node(long p, boolean w)
+    {
+        page = p;
+        dirty = w;
+    }
+
+    // An empty list: just the sentinel, linked to itself
+    static Node list()
+    {
+        Node s = new Node(-1, false);
+        s.next = s.prev = s;
+        return s;
+    }
+
+    static boolean isEmpty(Node list)
+    {
+        return list.next == list;
+    }
+
+    // Removes n from the circular doubly linked list it is in
+    static void unlink(Node n)
+    {
+        n.prev.next = n.next;
+        n.next.prev = n.prev;
+    }
+
+    // Adds n to the end of the list with sentinel list
+    static void append(Node list, Node n)
+    {
+        n.prev = list.prev;
+        n.next = list;
+        list.prev.next = n;
+        list.prev = n;
+    }
+
+    // Moves all of from's nodes onto the end of to, leaving from empty
+    static void splice(Node from, Node to)
+    {
+        if (from.next == from) return;
+        Node first = from.next, last = from.prev;
+        first.prev = to.prev;
+        to.prev.next = first;
+        last.next = to;
+        to.prev = last;
+        from.next = from.prev = from;
+    }
+}
@@ -0,0 +1,91 @@
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    Not-Recently-Used (NRU) algorithm. Evicts lowest based on classifications 0-3.
+        Class 0: not referenced, clean
+        Class 1: not referenced, dirty
+        Class 2: referenced, clean
+        Class 3: referenced, dirty
+    Also periodically sets all PTE's referenced bit to false;
+    Frames are kept in one list per class, so picking a victim (the oldest page of
+    the lowest non-empty class) is O(1). A refresh doesn't touch every frame either:
+    the epoch is bumped, which un-references them all, and the referenced lists
+    are spliced onto the unreferenced ones.
+ */
+class Nru extends Simulator
+{
+    final int refresh;         // Accesses between resetting the referenced bits
+    private final PageIndex<Node> index;            // Page # -> frame
+    private final Node[] nruClass = new Node[4];    // Frames bucketed by class (list sentinels)
+    private int epoch = 0, listLen = 0, reads = 0;  // epoch is bumped on every refresh
+
+    Nru(int frames, int refresh)
+    {
+        super(frames);
+        this.refresh = refresh;
+        index = new PageIndex<Node>(frames);
+        for (int i = 0; i < 4; i++) nruClass[i] = Node.list();
+    }
+
+    void access(long address, boolean write)
+    {
+        long page = address >> pageShift;
+        int  before;
+        Node temp;
+
+        if (reads >= refresh) // Set all referenced bits to false & reset read count
+        {
+            reads = 0;
+            epoch++;
+            Node.splice(nruClass[2], nruClass[0]);
+            Node.splice(nruClass[3], nruClass[1]);
+        }
+        reads++;
+
+        // Check the PT for page, if found update referenced & dirty (if necessary)
+        if ((temp = index.get(page)) != null)
+        {
+            hit(address);
+            before = classOf(temp);
+            temp.refEpoch = epoch;
+            if(write) temp.dirty = true;
+            if (classOf(temp) != before) // Move to the end of its new class
+            {
+                Node.unlink(temp);
+                Node.append(nruClass[classOf(temp)], temp);
+            }
+            return;
+        }
+
+        if (listLen < frames) // PT is not full
+        {
+            fault(address);
+            listLen++;
+            temp = new Node(page, write);
+        }
+        else // Page wasn't found. Evict the oldest page of the lowest class
+        {
+            int c = 0;
+            while (Node.isEmpty(nruClass[c])) c++;
+            temp = nruClass[c].next;
+
+            evict(address, temp);
+            Node.unlink(temp);
+            index.remove(temp.page);
+
+            // Replace current page with new page contents.
+            temp.page = page;
+            temp.dirty = write;
+        }
+        temp.refEpoch = epoch;
+        index.put(page, temp);
+        Node.append(nruClass[classOf(temp)], temp);
+    }
+
+    // NRU class of a frame: 2 if referenced since the last refresh, +1 if dirty
+    private int classOf(Node n)
+    {
+        return (n.refEpoch == epoch ? 2 : 0) | (n.dirty ? 1 : 0);
+    }
+}
@@ -0,0 +1,114 @@
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    Optimal page replacement algorithm. On fault, evicts the page that will be used
+    farthest in the future (if it is used at all).
+    Uses the trace's next-use array (one backward pass, see Trace.nextUse()).
+    Resident pages are kept in a max-heap keyed on their next use, so every access
+    costs O(log frames) instead of a scan of the PT.
+ */
+class Opt extends Simulator
+{
+    private final PageIndex<Node> index; // Page # -> frame
+    private final Node[] heap;           // Resident pages, max-heap on next use
+    private int listLen = 0;
+
+    Opt(int frames)
+    {
+        super(frames);
+        index = new PageIndex<Node>(frames);
+        heap = new Node[frames];
+    }
+
+    // OPT needs to know the future, it only runs on a whole trace
+    void access(long address, boolean write)
+    {
+        throw new UnsupportedOperationException("OPT needs the whole trace");
+    }
+
+    void run(TraceReader tr)
+    {
+        run(Trace.read(tr));
+    }
+
+    void run(Trace trace)
+    {
+        int[] nextUse = trace.nextUse(pageShift);
+        long  page;
+        Node  temp;
+
+        maccesses += trace.n;
+        for (int i = 0; i < trace.n; i++)
+        {
+            page = trace.address[i] >> pageShift;
+            if (tlb != null) tlb.translate(page);
+            if ((temp = index.get(page)) != null)
+            {
+                hit(trace.address[i]);
+                if (trace.write[i]) temp.dirty = true;
+                temp.readNum = nextUse[i]; // Next use only moves later
+                siftUp(temp.heapPos);
+            }
+            else
+            {
+                if (listLen < frames) // PT is not full
+                {
+                    fault(trace.address[i]);
+                    temp = new Node(page, trace.write[i]);
+                    temp.readNum = nextUse[i];
+                    temp.heapPos = listLen;
+                    heap[listLen++] = temp;
+                    siftUp(temp.heapPos);
+                }
+                else // Evict the page used farthest in the future, it's on top of the heap
+                {
+                    temp = heap[0];
+                    evict(trace.address[i], temp);
+                    index.remove(temp.page);
+
+                    // Reuse the frame for the new page
+                    temp.page = page;
+                    temp.dirty = trace.write[i];
+                    temp.readNum = nextUse[i];
+                    siftDown(0);
+                }
+                index.put(page, temp);
+            }
+            if (flusher != null) flusher.access();
+            if (metrics != null) metrics.access(page);
+        }
+        if (metrics != null) metrics.finish();
+    }
+
+    // Moves heap[i] up while its next use is later than its parent's
+    private void siftUp(int i)
+    {
+        Node n = heap[i];
+        while (i > 0 && heap[(i - 1) / 2].readNum < n.readNum)
+        {
+            heap[i] = heap[(i - 1) / 2];
+            heap[i].heapPos = i;
+            i = (i - 1) / 2;
+        }
+        heap[i] = n;
+        n.heapPos = i;
+    }
+
+    // Moves heap[i] down while a child's next use is later (only called on a full heap)
+    private void siftDown(int i)
+    {
+        Node n = heap[i];
+        int  c;
+        while ((c = 2 * i + 1) < heap.length)
+        {
+            if (c + 1 < heap.length && heap[c + 1].readNum > heap[c].readNum) c++;
+            if (heap[c].readNum <= n.readNum) break;
+            heap[i] = heap[c];
+            heap[i].heapPos = i;
+            i = c;
+        }
+        heap[i] = n;
+        n.heapPos = i;
+    }
+}
@@ -0,0 +1,120 @@
+import java.util.Arrays;
+
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    Hash table from a page number to the frame holding it. Keys live in a
+    primitive long[] (open addressing, linear probing) so lookups never box a
+    Long. Deleting shifts the following entries back instead of leaving
+    tombstones, so probe chains stay short no matter how many evictions.
+ */
+class PageIndex<V>
+{
+    private static final long EMPTY = Long.MIN_VALUE; // Never a valid key
+
+    private long[]   keys;
+    private Object[] vals;
+    private int      size, shift, mask;
+
+    /**
+        @param expected Number of keys expected, the table grows past it if needed
+    */
+    PageIndex(int expected)
+    {
+        allocate(Integer.highestOneBit(Math.max(2, expected) * 2 - 1) << 1);
+    }
+
+    private void allocate(int capacity)
+    {
+        keys  = new long[capacity];
+        vals  = new Object[capacity];
+        mask  = capacity - 1;
+        shift = 64 - Integer.numberOfTrailingZeros(capacity);
+        Arrays.fill(keys, EMPTY);
+        size = 0;
+    }
+
+    // Fibonacci hashing, spreads sequential page numbers over the table
+    private int home(long key)
+    {
+        return (int) ((key * 0x9E3779B97F4A7C15L) >>> shift);
+    }
+
+    /**
+        @return The value stored for key, null if there isn't one
+    */
+    @SuppressWarnings("unchecked")
+    V get(long key)
+    {
+        for (int i = home(key); keys[i] != EMPTY; i = (i + 1) & mask)
+            if (keys[i] == key) return (V) vals[i];
+        return null;
+    }
+
+    /**
+        Stores val for key, replacing what was there.
+    */
+    void put(long key, V val)
+    {
+        if ((size + 1) * 2 > keys.length) grow(); // Keep the load under 1/2
+
+        int i = home(key);
+        for (; keys[i] != EMPTY; i = (i + 1) & mask)
+            if (keys[i] == key) { vals[i] = val; return; }
+        keys[i] = key;
+        vals[i] = val;
+        size++;
+    }
+
+    /**
+        Removes key.
+        @return The value that was stored for key, null if there wasn't one
+    */
+    @SuppressWarnings("unchecked")
+    V remove(long key)
+    {
+        int i = home(key);
+        for (; keys[i] != key; i = (i + 1) & mask)
+            if (keys[i] == EMPTY) return null;
+
+        V old = (V) vals[i];
+
+        // Pull back any later entry of the chain that may no longer be reachable
+        for (int j = (i + 1) & mask; keys[j] != EMPTY; j = (j + 1) & mask)
+        {
+            int h = home(keys[j]);
+            // Entry j stays only if its home is cyclically in (i, j]
+            if (i <= j ? (i < h && h <= j) : (i < h || h <= j)) continue;
+            keys[i] = keys[j];
+            vals[i] = vals[j];
+            i = j;
+        }
+        keys[i] = EMPTY;
+        vals[i] = null;
+        size--;
+        return old;
+    }
+
+    int size()
+    {
+        return size;
+    }
+
+    void clear()
+    {
+        Arrays.fill(keys, EMPTY);
+        Arrays.fill(vals, null);
+        size = 0;
+    }
+
+    @SuppressWarnings("unchecked")
+    private void grow()
+    {
+        long[]   oldKeys = keys;
+        Object[] oldVals = vals;
+        allocate(keys.length * 2);
+        for (int i = 0; i < oldKeys.length; i++)
+            if (oldKeys[i] != EMPTY) put(oldKeys[i], (V) oldVals[i]);
+    }
+}
@@ -0,0 +1,331 @@
+import java.util.Arrays;
+import java.util.Locale;
+
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    Approximate simulation by spatial sampling (SHARDS, Waldspurger et al., FAST '15).
+    A page is sampled if hash(page) mod P < T: every access to it is kept & every
+    access to the other pages is dropped, so the sample has about R = T/P of the
+    pages & of the accesses. The sample behaves like the whole trace shrunk by R.
+    A policy with F frames is estimated by the same policy with R*F frames on the
+    sample (NRU's refresh & WSClock's window, in accesses, shrink by R too), with
+    its faults & writes scaled by 1/R.
+
+    Error bounds: the sampled pages are split into 16 groups by the top bits of the
+    same hash. Each group is an independent sample at rate R/16 with an estimate of
+    its own; the spread of those around their mean (the full estimate) gives its
+    standard error. Bounds are 1.96 standard errors (95%). They cover the sampling
+    noise, not the bias of rounding R*F to a whole number of frames.
+
+    Bias: only stack algorithms (LRU & OPT here) fault on a shrunk trace with
+    shrunk frames about as they do on the whole one. The others (clock, fifo, nru,
+    wsclock, arc, 2q, lfu) don't: on swim, CLOCK & FIFO came out about 17% & 23%
+    over the real counts, well outside their bounds. For them (biased()) the
+    spread of the groups is still reported, but only as sampling noise, not as a
+    confidence interval for the real count.
+
+    The LRU miss ratio curve (mrc()) uses the fixed size variant, so its memory
+    doesn't grow with the trace: at most smax pages are tracked. When one more
+    would be, T drops to the largest hash value among them & the pages with that
+    value are dropped. An access counts 1/R for the R at the time it is seen.
+ */
+class Shards
+{
+    static final int GROUPS = 16;                   // For the error bounds
+    static final int MIN_FRAMES = 100;              // Fewer sampled frames skew the estimates
+    private static final long MODULUS = 1L << 24;   // P
+    private static final long EMPTY = Long.MIN_VALUE;
+
+    private long threshold; // T
+
+    /**
+        @param rate Fraction of the pages to sample, (0, 1]
+    */
+    Shards(double rate)
+    {
+        threshold = Math.max(1, Math.min(MODULUS, Math.round(rate * MODULUS)));
+    }
+
+    double rate()
+    {
+        return (double) threshold / MODULUS;
+    }
+
+    // splitmix64's finalizer, a bijection that mixes every bit of the page number
+    static long hash(long page)
+    {
+        long z = page + 0x9E3779B97F4A7C15L;
+        z = (z ^ (z >>> 30)) * 0xBF58476D1CE4E5B9L;
+        z = (z ^ (z >>> 27)) * 0x94D049BB133111EBL;
+        return z ^ (z >>> 31);
+    }
+
+    /**
+        @return True unless name is a stack algorithm, whose estimates are unbiased
+    */
+    static boolean biased(String name)
+    {
+        return !name.equalsIgnoreCase("lru") && !name.equalsIgnoreCase("opt");
+    }
+
+    boolean sampled(long page)
+    {
+        return (hash(page) & (MODULUS - 1)) < threshold;
+    }
+
+    // Group of a page for the error bounds, independent of whether it's sampled
+    static int group(long page)
+    {
+        return (int) (hash(page) >>> 60);
+    }
+
+    /**
+        Shrinks a count on the whole trace (frames, accesses) to the sample.
+        @return At least 1, unless value is 0 or less (an algorithm's default)
+    */
+    int scale(int value)
+    {
+        return value <= 0 ? value : (int) Math.max(1, Math.round(value * rate()));
+    }
+
+    /**
+        @return A reader of tr's records to sampled pages
+    */
+    Sample sample(TraceReader tr, int pageShift)
+    {
+        return new Sample(tr, pageShift);
+    }
+
+    class Sample extends TraceReader
+    {
+        private final TraceReader tr;
+        private final int pageShift;
+        long total = 0; // Records read from tr, sampled or not
+
+        private Sample(TraceReader tr, int pageShift)
+        {
+            this.tr = tr;
+            this.pageShift = pageShift;
+        }
+
+        boolean next()
+        {
+            while (tr.next())
+            {
+                total++;
+                if (!sampled(tr.address >> pageShift)) continue;
+                address = tr.address;
+                write = tr.write;
+                time = tr.time;
+                return true;
+            }
+            return false;
+        }
+
+        void close()
+        {
+            tr.close();
+        }
+    }
+
+    /**
+        Counts a sampled simulator's faults & writes per group, set as its events.
+    */
+    class Estimate implements AccessEvents
+    {
+        private final int pageShift;
+        private final long[] faults = new long[GROUPS], writes = new long[GROUPS];
+
+        Estimate(int pageShift)
+        {
+            this.pageShift = pageShift;
+        }
+
+        public void hit(long address)
+        {
+        }
+
+        public void fault(long address)
+        {
+            faults[group(address >> pageShift)]++;
+        }
+
+        public void evict(long address, boolean dirty, long page)
+        {
+            faults[group(address >> pageShift)]++;
+            if (dirty) writes[group(page)]++;
+        }
+
+        double faults()      { return estimate(faults); }
+        double faultError()  { return error(faults); }
+        double writes()      { return estimate(writes); }
+        double writeError()  { return error(writes); }
+
+        private double estimate(long[] counts)
+        {
+            long sum = 0;
+            for (long c : counts) sum += c;
+            return sum / rate();
+        }
+
+        private double error(long[] counts)
+        {
+            double[] e = new double[GROUPS];
+            for (int g = 0; g < GROUPS; g++) e[g] = GROUPS * counts[g] / rate();
+            return bound(e);
+        }
+    }
+
+    // 1.96 standard errors of the mean of the group estimates e
+    private static double bound(double[] e)
+    {
+        double mean = 0, squares = 0;
+        for (double x : e) mean += x / e.length;
+        for (double x : e) squares += (x - mean) * (x - mean);
+        return 1.96 * Math.sqrt(squares / (e.length * (e.length - 1.0)));
+    }
+
+    /**
+        Prints frames,lru_faults,lru_faults_err,lru_fault_rate for 1..maxFrames,
+        estimated from at most smax pages. The sample size & final rate go to stderr.
+        @param rate Starting rate, lowered whenever more than smax pages are sampled
+        @param smax Most pages tracked at once, at most 2^24
+    */
+    static void mrc(String fileName, int maxFrames, int pageShift, double rate, int smax)
+    {
+        Shards      s = new Shards(rate);
+        TraceReader tr = TraceReader.open(fileName);
+        PageIndex<int[]> stamps = new PageIndex<int[]>(smax); // Page -> its last access' stamp
+        int         cap = 4 * smax;                 // Stamps before they're renumbered
+        int[]       tree = new int[cap + 1];        // Fenwick tree, 1 marks a page's last access
+        long[]      pageAt = new long[cap];         // Page of each marked stamp, EMPTY if none
+        long[]      heapValue = new long[smax + 1], heapPage = new long[smax + 1]; // Max-heap on hash mod P
+        double[][]  hist = new double[GROUPS][maxFrames + 2]; // Weight of each scaled distance
+        long        n = 0, sampled = 0;
+        int         clock = 0, tracked = 0;
+
+        Arrays.fill(pageAt, EMPTY);
+        while (tr.next())
+        {
+            long page = tr.address >> pageShift, h = hash(page), v = h & (MODULUS - 1);
+            n++;
+            if (v >= s.threshold) continue;
+
+            double r = s.rate();
+            int    d = maxFrames + 1; // Never seen: faults with any number of frames
+            int[]  stamp = stamps.get(page);
+            sampled++;
+            if (stamp != null)
+            {
+                // Distinct sampled pages touched since p's last access, plus p, scaled up
+                long dist = 1 + MissRatioCurve.sum(tree, clock) - MissRatioCurve.sum(tree, stamp[0] + 1);
+                d = (int) Math.min(maxFrames + 1, (long) (dist / r));
+                MissRatioCurve.add(tree, stamp[0] + 1, -1);
+                pageAt[stamp[0]] = EMPTY;
+            }
+            else
+            {
+                stamps.put(page, stamp = new int[1]);
+                heapValue[tracked] = v;
+                heapPage[tracked] = page;
+                siftUp(heapValue, heapPage, tracked++);
+            }
+            hist[(int) (h >>> 60)][d] += 1 / r;
+
+            if (clock == cap) clock = renumber(stamps, tree, pageAt);
+            stamp[0] = clock;
+            pageAt[clock] = page;
+            MissRatioCurve.add(tree, ++clock, 1);
+
+            // Over smax pages: lower T to the largest value & drop the pages at it
+            if (tracked > smax)
+            {
+                s.threshold = heapValue[0];
+                while (tracked > 0 && heapValue[0] == s.threshold)
+                {
+                    int[] old = stamps.remove(heapPage[0]);
+                    MissRatioCurve.add(tree, old[0] + 1, -1);
+                    pageAt[old[0]] = EMPTY;
+                    heapValue[0] = heapValue[--tracked];
+                    heapPage[0] = heapPage[tracked];
+                    siftDown(heapValue, heapPage, 0, tracked);
+                }
+            }
+        }
+        tr.close();
+
+        // Faults with F frames: the weight of scaled distances > F, per group
+        double[] faults = new double[GROUPS], e = new double[GROUPS];
+        StringBuilder out = new StringBuilder("frames,lru_faults,lru_faults_err,lru_fault_rate\n");
+        for (int g = 0; g < GROUPS; g++) faults[g] = hist[g][maxFrames + 1];
+        double[][] rows = new double[maxFrames + 1][];
+        for (int f = maxFrames; f >= 1; f--)
+        {
+            double total = 0;
+            for (int g = 0; g < GROUPS; g++)
+            {
+                total += faults[g];
+                e[g] = GROUPS * faults[g];
+            }
+            rows[f] = new double[] {total, bound(e)};
+            for (int g = 0; g < GROUPS; g++) faults[g] += hist[g][f];
+        }
+        // Rates are over the true access count, SHARDS-adj's correction for the
+        // sample holding more or fewer accesses than R*n
+        for (int f = 1; f <= maxFrames; f++)
+            out.append(f).append(',').append(Math.round(rows[f][0])).append(',')
+               .append(Math.round(rows[f][1])).append(',')
+               .append(String.format(Locale.ROOT, "%.6f", n > 0 ? rows[f][0] / n : 0)).append('\n');
+        System.out.print(out);
+        System.err.printf("Sampled %,d of %,d accesses, %,d pages tracked, final rate %.6f\n",
+            sampled, n, tracked, s.rate());
+    }
+
+    /*
+        Stamps ran out: renumbers the marked ones 0, 1, ... in order & rebuilds the
+        tree. At most smax are marked, so this happens once every 3*smax accesses.
+        @return The next free stamp
+    */
+    private static int renumber(PageIndex<int[]> stamps, int[] tree, long[] pageAt)
+    {
+        int next = 0;
+        Arrays.fill(tree, 0);
+        for (int i = 0; i < pageAt.length; i++)
+        {
+            if (pageAt[i] == EMPTY) continue;
+            long page = pageAt[i];
+            pageAt[i] = EMPTY;
+            pageAt[next] = page;
+            stamps.get(page)[0] = next;
+            MissRatioCurve.add(tree, ++next, 1);
+        }
+        return next;
+    }
+
+    private static void siftUp(long[] value, long[] page, int i)
+    {
+        for (int parent; i > 0 && value[parent = (i - 1) / 2] < value[i]; i = parent)
+            swap(value, page, i, parent);
+    }
+
+    private static void siftDown(long[] value, long[] page, int i, int size)
+    {
+        for (int child; (child = 2 * i + 1) < size; i = child)
+        {
+            if (child + 1 < size && value[child + 1] > value[child]) child++;
+            if (value[i] >= value[child]) return;
+            swap(value, page, i, child);
+        }
+    }
+
+    private static void swap(long[] value, long[] page, int i, int j)
+    {
+        long v = value[i], p = page[i];
+        value[i] = value[j];
+        page[i] = page[j];
+        value[j] = v;
+        page[j] = p;
+    }
+}
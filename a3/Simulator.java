@@ -0,0 +1,158 @@
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    A page replacement algorithm with its own page table & counters, so any number
+    of them can run in one process. Subclasses handle one access at a time in
+    access(); OPT has to see the whole trace first, so it overrides run(Trace).
+ */
+abstract class Simulator
+{
+    int frames;         // Number of frames in the PT (a process's quota can change)
+    long maccesses = 0, // Number of memory accesses (long, traces can pass 2^31)
+         faults    = 0, // Number of page faults
+         writes    = 0; // Number of dirty pages written to disk
+    AccessEvents events = null; // Told about every access, if set
+    Tlb  tlb = null;            // Translation cost model, if set
+    Metrics metrics = null;     // Windowed time series, if set
+    Flusher flusher = null;     // Disk & background write-back model, if set
+    int  pageShift = 12;        // log2 of the page size
+
+    Simulator(int frames)
+    {
+        this.frames = frames;
+    }
+
+    /**
+        @param name opt, clock, fifo, nru, lru, wsclock, arc, 2q or lfu (any case)
+        @param frames Number of frames in the PT
+        @param param NRU: accesses between resetting the referenced bits.
+                     WSClock: working set window in accesses (0 means frames).
+        @return The simulator, null if there's no algorithm by that name
+    */
+    static Simulator create(String name, int frames, int param)
+    {
+        switch (name.toLowerCase())
+        {
+            case "opt":     return new Opt(frames);
+            case "clock":   return new Clock(frames);
+            case "fifo":    return new Fifo(frames);
+            case "nru":     return new Nru(frames, param);
+            case "lru":     return new Lru(frames);
+            case "wsclock": return new WsClock(frames, param > 0 ? param : frames);
+            case "arc":     return new Arc(frames);
+            case "2q":      return new TwoQueue(frames);
+            case "lfu":     return new Lfu(frames);
+            default:        return null;
+        }
+    }
+
+    /**
+        @return Which of create()'s param the algorithm uses: "refresh", "window" or null
+    */
+    static String paramName(String name)
+    {
+        if (name.equalsIgnoreCase("nru")) return "refresh";
+        if (name.equalsIgnoreCase("wsclock")) return "window";
+        return null;
+    }
+
+    /**
+        Simulates one memory access.
+        @param address Address read from the trace file
+        @param write True if the page is being written
+    */
+    abstract void access(long address, boolean write);
+
+    /**
+        One access through the whole pipeline: TLB, the algorithm, then metrics.
+    */
+    void step(long address, boolean write)
+    {
+        maccesses++;
+        if (tlb != null) tlb.translate(address >> pageShift);
+        access(address, write);
+        if (flusher != null) flusher.access();
+        if (metrics != null) metrics.access(address >> pageShift);
+    }
+
+    /**
+        Simulates every access left in tr, then closes it.
+    */
+    void run(TraceReader tr)
+    {
+        while (tr.next()) step(tr.address, tr.write);
+        tr.close();
+        if (metrics != null) metrics.finish();
+    }
+
+    /**
+        Simulates every access of a decoded trace.
+    */
+    void run(Trace trace)
+    {
+        for (int i = 0; i < trace.n; i++) step(trace.address[i], trace.write[i]);
+        if (metrics != null) metrics.finish();
+    }
+
+    /**
+        Gives up one frame, evicting a page the way a fault would if every frame is
+        in use. Only algorithms that override it can have their quota shrunk.
+        @return False if the algorithm can't give frames back
+    */
+    boolean release()
+    {
+        return false;
+    }
+
+    /**
+        Frames in the order the algorithm will reach them when it next evicts, for
+        the flusher: the first if n is null, else the one after n (null past the
+        last). Only algorithms that override it can have a flusher.
+    */
+    Node upcoming(Node n)
+    {
+        throw new UnsupportedOperationException("No eviction order to flush ahead of");
+    }
+
+    /**
+        @return The frame holding page, null if it isn't resident (or the algorithm
+                can't tell, which turns off the flusher's coalescing)
+    */
+    Node resident(long page)
+    {
+        return null;
+    }
+
+    void hit(long address)
+    {
+        if (events != null) events.hit(address);
+    }
+
+    // Fault while there are still free frames
+    void fault(long address)
+    {
+        faults++;
+        if (flusher != null) flusher.fault(false);
+        if (events != null) events.fault(address);
+    }
+
+    // A frame given back by release(), victim is the page that was in it (or null)
+    void released(Node victim)
+    {
+        frames--;
+        if (victim == null) return;
+        if (victim.dirty) writes++;
+        if (tlb != null) tlb.invalidate(victim.page);
+    }
+
+    // Fault that evicts victim (call before victim is reused)
+    void evict(long address, Node victim)
+    {
+        faults++;
+        if (victim.dirty) writes++;
+        if (flusher != null) flusher.fault(victim.dirty);
+        if (tlb != null) tlb.invalidate(victim.page);
+        if (events != null) events.evict(address, victim.dirty, victim.page);
+    }
+}
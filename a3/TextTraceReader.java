@@ -0,0 +1,107 @@
+import java.io.*;
+import java.util.zip.GZIPInputStream;
+
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    Reads a text trace one record ("<hex address> <R|W>" per line, optionally
+    followed by a decimal timestamp) at a time,
+    parsing straight out of a byte buffer, so nothing is allocated per record.
+    Files ending in .gz are decompressed on the fly.
+ */
+class TextTraceReader extends TraceReader
+{
+    private static final int BUFFER_SIZE = 1 << 16;
+
+    private InputStream in;
+    private final byte[] buf = new byte[BUFFER_SIZE];
+    private int pos = 0, len = 0;
+    private long records = 0;
+
+    /**
+        Opens a text trace, exits if it can't be opened.
+        @param fileName Trace file, gzip compressed if it ends in .gz
+    */
+    TextTraceReader(String fileName)
+    {
+        try
+        {
+            in = new FileInputStream(fileName);
+            if (fileName.endsWith(".gz")) in = new GZIPInputStream(in, BUFFER_SIZE);
+        }
+        catch (IOException e)
+        {
+            System.out.println("Error opening file. Exiting.");
+            System.exit(0);
+        }
+    }
+
+    // Next byte of the file, -1 at the end
+    private int read()
+    {
+        if (pos == len)
+        {
+            try { len = in.read(buf, 0, BUFFER_SIZE); }
+            catch (IOException e)
+            {
+                System.out.println("Error reading file. Exiting.");
+                System.exit(0);
+            }
+            pos = 0;
+            if (len <= 0) { len = 0; return -1; }
+        }
+        return buf[pos++] & 0xff;
+    }
+
+    private static int hexValue(int c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    // Stops at the end of the file (or at a line that isn't a record)
+    boolean next()
+    {
+        int c, digit;
+
+        do c = read(); while (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+        if ((digit = hexValue(c)) < 0) return false;
+
+        address = 0;
+        do
+        {
+            address = (address << 4) | digit;
+            c = read();
+        } while ((digit = hexValue(c)) >= 0);
+
+        while (c == ' ' || c == '\t') c = read();
+        write = c == 'W' || c == 'w';
+
+        // Optional timestamp
+        if (c != '\n' && c != -1) c = read();
+        while (c == ' ' || c == '\t') c = read();
+        if (c >= '0' && c <= '9')
+        {
+            time = 0;
+            do
+            {
+                time = time * 10 + (c - '0');
+                c = read();
+            } while (c >= '0' && c <= '9');
+        }
+        else time = records;
+        records++;
+
+        while (c != '\n' && c != -1) c = read(); // Skip the rest of the line
+        return true;
+    }
+
+    void close()
+    {
+        try { in.close(); }
+        catch (IOException e) {}
+    }
+}
@@ -0,0 +1,118 @@
+import java.util.Arrays;
+
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    Translation cost model, run on every access next to the replacement policy.
+        TLB         set associative, LRU within a set. Entries of evicted pages
+                    are shot down.
+        page walk   on a TLB miss, one memory reference per level of a radix page
+                    table: 2 levels (32 bit addresses, 10 bits a level) or 4 levels
+                    (48 bit addresses, 9 bits a level). A huge page ends the walk
+                    early (2 MB: one level less with 4 levels, 4 MB with 2 levels).
+                    A small direct mapped cache of upper level entries (like a
+                    page walk cache) lets a walk skip the levels it already knows.
+ */
+class Tlb
+{
+    private static final int WALK_CACHE = 16; // Entries per upper level
+
+    private final int    sets, ways, depth, bits;
+    private final long[] tags;      // Page # in each way, -1 if empty
+    private final long[] stamps;    // Last use of each way, 0 if empty
+    private final long[][] walkTags; // [level][slot] prefix of a cached upper level entry
+    private long stamp = 0;
+
+    long lookups = 0, hits = 0, walks = 0, walkRefs = 0;
+
+    /**
+        @param entries TLB entries, rounded down to a multiple of ways
+        @param ways Associativity (entries for fully associative)
+        @param levels Page table levels, 2 or 4
+        @param pageShift log2 of the page size
+    */
+    Tlb(int entries, int ways, int levels, int pageShift)
+    {
+        this.ways = ways;
+        sets = Math.max(1, entries / ways);
+        bits = levels == 2 ? 10 : 9;
+        depth = Math.max(1, levels - (pageShift - 12) / bits);
+        tags = new long[sets * ways];
+        stamps = new long[sets * ways];
+        Arrays.fill(tags, -1);
+        walkTags = new long[depth][WALK_CACHE];
+        for (long[] level : walkTags) Arrays.fill(level, -1);
+    }
+
+    /**
+        Looks page up in the TLB, walks the page table & fills the TLB on a miss.
+    */
+    void translate(long page)
+    {
+        int set = (int) (page % sets) * ways, victim = set;
+
+        lookups++;
+        stamp++;
+        for (int i = set; i < set + ways; i++)
+        {
+            if (tags[i] == page)
+            {
+                hits++;
+                stamps[i] = stamp;
+                return;
+            }
+            if (stamps[i] < stamps[victim]) victim = i;
+        }
+        walk(page);
+        tags[victim] = page;
+        stamps[victim] = stamp;
+    }
+
+    // Counts the memory references of a walk: the levels below the deepest cached one
+    private void walk(long page)
+    {
+        int from = 0;
+        for (int level = depth - 2; level >= 0; level--)
+        {
+            long prefix = page >>> (bits * (depth - 1 - level));
+            if (walkTags[level][(int) (prefix % WALK_CACHE)] == prefix)
+            {
+                from = level + 1;
+                break;
+            }
+        }
+        for (int level = from; level < depth - 1; level++) // Cache what was read
+        {
+            long prefix = page >>> (bits * (depth - 1 - level));
+            walkTags[level][(int) (prefix % WALK_CACHE)] = prefix;
+        }
+        walks++;
+        walkRefs += depth - from;
+    }
+
+    /**
+        Drops page's entry, if it has one (the page was evicted).
+    */
+    void invalidate(long page)
+    {
+        int set = (int) (page % sets) * ways;
+        for (int i = set; i < set + ways; i++)
+            if (tags[i] == page)
+            {
+                tags[i] = -1;
+                stamps[i] = 0;
+            }
+    }
+
+    double hitRate()
+    {
+        return lookups == 0 ? 0 : (double) hits / lookups;
+    }
+
+    // Memory references per walk
+    double walkCost()
+    {
+        return walks == 0 ? 0 : (double) walkRefs / walks;
+    }
+}
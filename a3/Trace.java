@@ -0,0 +1,88 @@
+import java.util.Arrays;
+
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    A whole trace decoded into primitive arrays. Read-only once built, so any
+    number of simulators can share one (vmsim's sweep mode runs them in parallel).
+ */
+class Trace
+{
+    static final int MAX_ACCESSES = Integer.MAX_VALUE - 8; // Largest array the JVM allocates
+
+    final int       n;       // Number of accesses
+    final long[]    address; // Address of every access
+    final boolean[] write;   // True for every access that is a write
+    private int[]   nextUse;
+    private int     nextUseShift;
+
+    Trace(int n, long[] address, boolean[] write)
+    {
+        this.n = n;
+        this.address = address;
+        this.write = write;
+    }
+
+    /**
+        Reads a whole trace, exits if it can't be opened.
+        @param fileName Trace file (any format TraceReader.open takes)
+    */
+    static Trace read(String fileName)
+    {
+        return read(TraceReader.open(fileName));
+    }
+
+    /**
+        Reads the rest of tr & closes it. The size is known up front for .vmt files.
+        Exits if there are more than MAX_ACCESSES records.
+    */
+    static Trace read(TraceReader tr)
+    {
+        int       n = 0;
+        long[]    address = new long[tr.count() >= 0 ? (int) Math.min(tr.count(), MAX_ACCESSES) : 1 << 16];
+        boolean[] write = new boolean[address.length];
+
+        while (tr.next())
+        {
+            if (n == address.length)
+            {
+                if (n == MAX_ACCESSES)
+                {
+                    System.out.println("Error: trace too long to hold in memory, sample it. Exiting.");
+                    System.exit(0);
+                }
+                int grown = (int) Math.min(MAX_ACCESSES, 2L * n);
+                address = Arrays.copyOf(address, grown);
+                write = Arrays.copyOf(write, grown);
+            }
+            address[n] = tr.address;
+            write[n++] = tr.write;
+        }
+        tr.close();
+        return new Trace(n, address, write);
+    }
+
+    /**
+        For every access, the index of the next access to the same page, n if there
+        isn't one. Worked out (with one backward pass) the first time it is asked for.
+        @param pageShift log2 of the page size
+    */
+    synchronized int[] nextUse(int pageShift)
+    {
+        if (nextUse != null && nextUseShift == pageShift) return nextUse;
+
+        // last holds one int[1] per distinct page, so the pass doesn't box anything
+        int[] next = new int[n];
+        PageIndex<int[]> last = new PageIndex<int[]>(1024);
+        for (int i = n - 1; i >= 0; i--)
+        {
+            int[] seen = last.get(address[i] >> pageShift);
+            if (seen == null) last.put(address[i] >> pageShift, seen = new int[] {n});
+            next[i] = seen[0];
+            seen[0] = i;
+        }
+        nextUseShift = pageShift;
+        return nextUse = next;
+    }
+}
@@ -0,0 +1,227 @@
+import java.util.SplittableRandom;
+
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    Synthetic trace, generated as it is read, so it streams into a simulation or a
+    conversion (vmsim -c) without ever being stored. A spec is one or more phases
+    joined by '+', each a model with optional key=value settings, e.g.
+        gen:zipf:pages=65536,s=0.99+loop:pages=2048,n=500000
+    models
+        uniform   every page equally likely
+        zipf      the k-th page with probability ~ 1/k^s (rejection-inversion
+                  sampling, O(1) time & memory whatever the number of pages)
+        hot       a hot set of the first hot pages gets a share p of the accesses,
+                  the rest go uniformly to the other pages
+        loop      a scan over pages, repeated
+        seq       a scan that never comes back (pages defaults to n / run)
+    settings
+        n         records in the phase (default 1000000), 1e6 style is fine
+        pages     pages the phase touches (default 10000)
+        base      first page number (default: after the previous phase's pages)
+        w         fraction of the records that are writes (default 0.25)
+        run       records in a row to each page picked, at rising offsets (default 1)
+        s         zipf exponent (default 0.99)
+        hot, p    hot: size of the hot set (default pages / 10) & its share (default 0.9)
+        seed      random seed (default 1), each phase gets its own stream
+    Pages are 4 KB. time is the record index.
+ */
+class TraceGen extends TraceReader
+{
+    static final String PREFIX = "gen:";
+
+    private final Phase[] phases;
+    private final long    count;        // Records in all the phases
+    private int  phase = -1;
+    private long left = 0, index = 0;   // Records left in the phase, records so far
+    private long runPage;               // Page of the current run
+    private int  inRun = 0;             // Records of the run so far
+
+    /**
+        Parses a spec, exits if it isn't valid.
+        @param spec "gen:" followed by the phases
+    */
+    TraceGen(String spec)
+    {
+        String[] parts = spec.substring(PREFIX.length()).split("\\+");
+        SplittableRandom root = null;
+        long base = 0, n = 0;
+
+        phases = new Phase[parts.length];
+        try
+        {
+            for (int i = 0; i < parts.length; i++)
+            {
+                Phase ph = phases[i] = new Phase(parts[i], base);
+                if (root == null) root = new SplittableRandom(ph.seed);
+                ph.rng = ph.seedGiven ? new SplittableRandom(ph.seed) : root.split();
+                base = ph.base + ph.pages;
+                n += ph.n;
+            }
+        }
+        catch (RuntimeException e)
+        {
+            System.out.println("Invalid trace spec. Exiting.");
+            System.exit(0);
+        }
+        count = n;
+    }
+
+    boolean next()
+    {
+        while (left == 0)
+        {
+            if (++phase == phases.length)
+            {
+                phase--;
+                return false;
+            }
+            left = phases[phase].n;
+            inRun = 0;
+        }
+
+        Phase ph = phases[phase];
+        if (inRun == 0) runPage = ph.base + ph.pick();
+        address = runPage << 12 | (long) inRun * ph.stride;
+        if (++inRun == ph.run) inRun = 0;
+        write = ph.w > 0 && ph.rng.nextDouble() < ph.w;
+        time = index++;
+        left--;
+        return true;
+    }
+
+    long count()
+    {
+        return count;
+    }
+
+    void close()
+    {
+    }
+
+    // One phase of the spec & its generator state
+    private static class Phase
+    {
+        String  model;
+        long    n = 1000000, pages = 10000, base, hot = -1, seed = 1, pos = 0;
+        double  w = 0.25, s = 0.99, p = 0.9;
+        int     run = 1, stride;
+        boolean seedGiven = false;
+        SplittableRandom rng;
+        Zipf    zipf;
+
+        // Throws on anything it can't make sense of
+        Phase(String text, long base)
+        {
+            String[] mk = text.split(":", 2);
+            boolean  pagesGiven = false;
+
+            model = mk[0];
+            this.base = base;
+            if (mk.length > 1) for (String kv : mk[1].split(","))
+            {
+                String[] f = kv.split("=", 2);
+                double   v = Double.parseDouble(f[1]);
+                switch (f[0])
+                {
+                    case "n":     n = (long) v; break;
+                    case "pages": pages = (long) v; pagesGiven = true; break;
+                    case "base":  this.base = (long) v; break;
+                    case "w":     w = v; break;
+                    case "run":   run = (int) v; break;
+                    case "s":     s = v; break;
+                    case "hot":   hot = (long) v; break;
+                    case "p":     p = v; break;
+                    case "seed":  seed = (long) v; seedGiven = true; break;
+                    default:      throw new IllegalArgumentException();
+                }
+            }
+            if (model.equals("seq") && !pagesGiven) pages = Math.max(1, (n + run - 1) / run);
+            if (hot < 0) hot = Math.max(1, pages / 10);
+            if (n < 0 || pages < 1 || this.base < 0 || w < 0 || w > 1 || run < 1 || s <= 0
+                || hot > pages || p < 0 || p > 1 || this.base + pages > 1L << 51)
+                throw new IllegalArgumentException();
+            if (model.equals("zipf")) zipf = new Zipf(pages, s);
+            else if (!model.matches("uniform|hot|loop|seq")) throw new IllegalArgumentException();
+            stride = Math.max(4, 4096 / run & ~3);
+            if (run > 4096 / 4) stride = 0; // More records than words in a page, stay put
+        }
+
+        // Next page, 0..pages-1
+        long pick()
+        {
+            switch (model)
+            {
+                case "uniform": return rng.nextLong(pages);
+                case "zipf":    return zipf.sample(rng) - 1;
+                case "hot":
+                    if (hot == pages || rng.nextDouble() < p) return rng.nextLong(hot);
+                    return hot + rng.nextLong(pages - hot);
+                default:        return pos++ % pages; // loop, seq
+            }
+        }
+    }
+
+    /*
+        Zipf sampler by rejection-inversion (Hormann & Derflinger, 1996): inverts the
+        integral of x^-s, a continuous hat over the probabilities, and rejects the
+        few draws that land outside them. Returns 1..n.
+    */
+    private static class Zipf
+    {
+        private final long   n;
+        private final double s, hX1, hN, cut;
+
+        Zipf(long n, double s)
+        {
+            this.n = n;
+            this.s = s;
+            hX1 = hIntegral(1.5) - 1;
+            hN = hIntegral(n + 0.5);
+            cut = 2 - hIntegralInverse(hIntegral(2.5) - h(2));
+        }
+
+        long sample(SplittableRandom rng)
+        {
+            while (true)
+            {
+                double u = hN + rng.nextDouble() * (hX1 - hN);
+                double x = hIntegralInverse(u);
+                long   k = Math.max(1, Math.min(n, (long) (x + 0.5)));
+                if (k - x <= cut || u >= hIntegral(k + 0.5) - h(k)) return k;
+            }
+        }
+
+        private double h(double x)
+        {
+            return Math.exp(-s * Math.log(x));
+        }
+
+        // Integral of x^-s, shifted so it is continuous at s = 1
+        private double hIntegral(double x)
+        {
+            double logX = Math.log(x);
+            return expm1x((1 - s) * logX) * logX;
+        }
+
+        private double hIntegralInverse(double x)
+        {
+            double t = Math.max(-1, x * (1 - s));
+            return Math.exp(log1px(t) * x);
+        }
+
+        // log(1 + x) / x & (e^x - 1) / x, with their series near 0
+        private static double log1px(double x)
+        {
+            if (Math.abs(x) > 1e-8) return Math.log1p(x) / x;
+            return 1 - x * (0.5 - x * (1 / 3.0 - x * 0.25));
+        }
+
+        private static double expm1x(double x)
+        {
+            if (Math.abs(x) > 1e-8) return Math.expm1(x) / x;
+            return 1 + x * 0.5 * (1 + x / 3.0 * (1 + x * 0.25));
+        }
+    }
+}
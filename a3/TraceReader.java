@@ -0,0 +1,49 @@
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    One trace record ("<hex address> <R|W> [timestamp]") at a time. The reader is picked by
+    the file's extension:
+        .vmt    binary trace, memory mapped (see VmtTraceReader)
+        .gz     gzip compressed text trace
+        other   text trace
+    and a name starting with "gen:" is a synthetic trace (see TraceGen).
+
+    usage:
+        TraceReader tr = TraceReader.open(fileName);
+        while (tr.next()) ... tr.address, tr.write ...
+ */
+abstract class TraceReader
+{
+    long    address; // Address of the current record
+    boolean write;   // True if the current record is a write
+    long    time;    // Timestamp of the current record, its index if the trace has none
+
+    /**
+        Opens a trace file, exits if it can't be opened.
+        @param fileName Trace file
+        @return Reader positioned before the first record
+    */
+    static TraceReader open(String fileName)
+    {
+        if (fileName.startsWith(TraceGen.PREFIX)) return new TraceGen(fileName);
+        if (fileName.endsWith(VmtTraceReader.EXTENSION)) return new VmtTraceReader(fileName);
+        return new TextTraceReader(fileName);
+    }
+
+    /**
+        Reads the next record into address, write & time.
+        @return False at the end of the trace
+    */
+    abstract boolean next();
+
+    /**
+        @return Number of records in the trace, -1 if it isn't known up front
+    */
+    long count()
+    {
+        return -1;
+    }
+
+    abstract void close();
+}
@@ -0,0 +1,110 @@
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    2Q algorithm (Johnson & Shasha, full version). A page seen for the first time
+    goes into A1in, a FIFO of about a quarter of the frames. Pages pushed out of
+    A1in are remembered (page number only) in A1out, a FIFO the size of half the
+    frames; a page faulted on while in A1out has been used twice, so it goes into
+    Am, the LRU list holding the rest. Pages only seen once are evicted without
+    pushing out the hot pages in Am. All lists share one index: O(1) per access.
+ */
+class TwoQueue extends Simulator
+{
+    private static final int A1IN = 0, A1OUT = 1, AM = 2;
+
+    private final PageIndex<Node> index; // Page # -> node, resident or in A1out
+    private final Node[] lists = new Node[3];  // Oldest first
+    private final int[]  size = new int[3];
+    private final int    kin, kout;            // Sizes of A1in & A1out
+
+    TwoQueue(int frames)
+    {
+        super(frames);
+        kin = Math.max(1, frames / 4);
+        kout = Math.max(1, frames / 2);
+        index = new PageIndex<Node>(frames + kout);
+        for (int i = 0; i < 3; i++) lists[i] = Node.list();
+    }
+
+    void access(long address, boolean write)
+    {
+        long page = address >> pageShift;
+        Node x = index.get(page);
+
+        if (x != null && x.where != A1OUT)
+        {
+            hit(address);
+            if(write) x.dirty = true;
+            if (x.where == AM) move(x, AM); // A1in is FIFO, a hit there doesn't move
+            return;
+        }
+
+        if (x != null) // Seen before, take it out of A1out first so reclaim can't drop it
+        {
+            Node.unlink(x);
+            size[A1OUT]--;
+            reclaim(address);
+            x.dirty = write;
+            x.where = AM;
+            Node.append(lists[AM], x);
+            size[AM]++;
+            return;
+        }
+
+        Node free = reclaim(address);
+
+        x = free != null ? free : new Node(page, write);
+        x.page = page;
+        x.dirty = write;
+        index.put(page, x);
+        x.where = A1IN;
+        Node.append(lists[A1IN], x);
+        size[A1IN]++;
+    }
+
+    /*
+        Finds a frame for a faulting page. The oldest A1in page is paged out (& its
+        number remembered in A1out) if A1in is over its share, else the oldest Am page.
+        @return A node the caller may reuse, null if it should allocate one
+    */
+    private Node reclaim(long address)
+    {
+        if (size[A1IN] + size[AM] < frames) // Free frame
+        {
+            fault(address);
+            return null;
+        }
+
+        Node victim;
+        if (size[A1IN] > kin || size[AM] == 0)
+        {
+            victim = lists[A1IN].next;
+            evict(address, victim);
+            victim.dirty = false;
+            move(victim, A1OUT);
+            if (size[A1OUT] <= kout) return null;
+
+            victim = lists[A1OUT].next; // A1out is full, forget its oldest page
+        }
+        else
+        {
+            victim = lists[AM].next;
+            evict(address, victim);
+        }
+        Node.unlink(victim);
+        size[victim.where]--;
+        index.remove(victim.page);
+        return victim;
+    }
+
+    // Moves n to the newest end of list to
+    private void move(Node n, int to)
+    {
+        Node.unlink(n);
+        size[n.where]--;
+        Node.append(lists[to], n);
+        size[to]++;
+        n.where = to;
+    }
+}
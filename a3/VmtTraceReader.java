@@ -0,0 +1,184 @@
+import java.io.*;
+import java.nio.ByteOrder;
+import java.nio.MappedByteBuffer;
+import java.nio.channels.FileChannel;
+
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    Binary (.vmt) trace, memory mapped so runs start without parsing text.
+
+    format:
+        "VMT1"                  magic
+        8 byte record count     (big endian)
+        one varint per record   (7 bits a byte, low bits first, high bit = more)
+    A record's varint is zigzag(address - previous address) << 1 | W, with the
+    previous address starting at 0. Nearby accesses mostly take 1-3 bytes.
+    Addresses are kept whole (not just page numbers) so converting back to text
+    gives the same trace; deltas must fit in 62 bits, which any real trace does.
+ */
+class VmtTraceReader extends TraceReader
+{
+    static final String EXTENSION = ".vmt";
+
+    private static final int  MAGIC  = 0x564d5431; // "VMT1"
+    private static final int  HEADER = 12;
+    private static final long WINDOW = 1L << 30; // Bytes mapped at a time
+
+    private FileChannel      channel;
+    private MappedByteBuffer map;
+    private long             mapStart, size, count, left;
+
+    /**
+        Opens & maps a binary trace, exits if it can't be opened or isn't one.
+        @param fileName Trace file ending in .vmt
+    */
+    VmtTraceReader(String fileName)
+    {
+        try
+        {
+            channel = new RandomAccessFile(fileName, "r").getChannel();
+            size = channel.size();
+            remap(0);
+            if (size < HEADER || map.getInt() != MAGIC)
+            {
+                System.out.println("Not a " + EXTENSION + " trace. Exiting.");
+                System.exit(0);
+            }
+            count = left = map.getLong();
+        }
+        catch (IOException e)
+        {
+            System.out.println("Error opening file. Exiting.");
+            System.exit(0);
+        }
+    }
+
+    // Maps up to WINDOW bytes of the file starting at offset
+    private void remap(long offset) throws IOException
+    {
+        mapStart = offset;
+        map = channel.map(FileChannel.MapMode.READ_ONLY, offset, Math.min(WINDOW, size - offset));
+        map.order(ByteOrder.BIG_ENDIAN);
+    }
+
+    boolean next()
+    {
+        if (left == 0) return false;
+        left--;
+
+        // A varint is at most 10 bytes, slide the window before it can run off the end
+        if (map.remaining() < 10 && mapStart + map.limit() < size)
+        {
+            try { remap(mapStart + map.position()); }
+            catch (IOException e)
+            {
+                System.out.println("Error reading file. Exiting.");
+                System.exit(0);
+            }
+        }
+
+        long v = 0;
+        int  b, shift = 0;
+        do
+        {
+            if (!map.hasRemaining()) // Header promised more records than there are
+            {
+                left = 0;
+                return false;
+            }
+            b = map.get();
+            v |= (long) (b & 0x7f) << shift;
+            shift += 7;
+        } while (b < 0);
+
+        write = (v & 1) != 0;
+        v >>>= 1;
+        address += (v >>> 1) ^ -(v & 1); // Undo the zigzag
+        time = count - left - 1;
+        return true;
+    }
+
+    long count()
+    {
+        return count;
+    }
+
+    void close()
+    {
+        try { channel.close(); }
+        catch (IOException e) {}
+        map = null;
+    }
+
+    /**
+        Writes any trace out again, as .vmt if to ends in .vmt, as text otherwise.
+        @param from Trace to read (any format TraceReader.open takes)
+        @param to File to write, "-" for text on stdout
+        @return Number of records written
+    */
+    static long convert(String from, String to) throws IOException
+    {
+        TraceReader  tr = TraceReader.open(from);
+        long         n = 0, last = 0;
+        boolean      binary = to.endsWith(EXTENSION), stdout = to.equals("-");
+        OutputStream out = new BufferedOutputStream(stdout ? System.out : new FileOutputStream(to), 1 << 16);
+        byte[]       line = new byte[19];
+
+        if (binary)
+        {
+            DataOutputStream header = new DataOutputStream(out);
+            header.writeInt(MAGIC);
+            header.writeLong(0); // Record count, filled in at the end
+        }
+
+        while (tr.next())
+        {
+            if (binary)
+            {
+                long d = tr.address - last;
+                long v = ((d << 1) ^ (d >> 63)) << 1 | (tr.write ? 1 : 0);
+                last = tr.address;
+                while ((v & ~0x7fL) != 0)
+                {
+                    out.write((int) (v & 0x7f) | 0x80);
+                    v >>>= 7;
+                }
+                out.write((int) v);
+            }
+            else
+                out.write(line, 0, textLine(line, tr.address, tr.write));
+            n++;
+        }
+        tr.close();
+        if (stdout) out.flush();
+        else out.close();
+
+        if (binary)
+        {
+            RandomAccessFile raf = new RandomAccessFile(to, "rw");
+            raf.seek(4);
+            raf.writeLong(n);
+            raf.close();
+        }
+        return n;
+    }
+
+    /*
+        Formats a record the way the course traces have it, e.g. "0041f7a0 R\n" (at
+        least 8 hex digits), without String.format, which would be most of the time
+        spent writing a big trace.
+        @return Length of the line
+    */
+    private static int textLine(byte[] line, long address, boolean write)
+    {
+        int digits = Math.max(8, (67 - Long.numberOfLeadingZeros(address)) / 4);
+        for (int i = digits - 1; i >= 0; i--, address >>>= 4)
+            line[i] = (byte) "0123456789abcdef".charAt((int) (address & 15));
+        line[digits] = ' ';
+        line[digits + 1] = (byte) (write ? 'W' : 'R');
+        line[digits + 2] = '\n';
+        return digits + 3;
+    }
+}
@@ -0,0 +1,88 @@
+/**
+    @author Nicolas Leo
+    CS 1550 Project 3
+
+    WSClock algorithm. Clock, but a page is only evicted once it has left the
+    working set: it hasn't been used for more than window accesses (virtual time).
+    On fault the hand goes around the frames:
+        referenced          clear the bit, note the time, move on
+        old & clean         evict it
+        old & dirty         write it back (it's clean from then on), move on
+    If a whole lap finds nothing, the first page it wrote back is evicted; if it
+    wrote none, the first clean page; if every page is dirty, the page at the hand.
+ */
+class WsClock extends Simulator
+{
+    final int window;         // Working set window, in accesses
+    private final PageIndex<Node> index; // Page # -> frame
+    private Node hand, tail;             // tail.next is the first frame added
+    private int  listLen = 0, now = 0;   // now is the virtual time
+
+    WsClock(int frames, int window)
+    {
+        super(frames);
+        this.window = window;
+        index = new PageIndex<Node>(frames);
+    }
+
+    void access(long address, boolean write)
+    {
+        long page = address >> pageShift;
+        Node temp = index.get(page);
+
+        now++;
+        if (temp != null)
+        {
+            hit(address);
+            temp.referenced = true;
+            if(write) temp.dirty = true;
+            return;
+        }
+
+        if (listLen < frames) // PT is not full, add the page after the last frame
+        {
+            fault(address);
+            listLen++;
+            temp = new Node(page, write);
+            if (tail == null) hand = temp.next = temp;
+            else
+            {
+                temp.next = tail.next;
+                tail.next = temp;
+            }
+            tail = temp;
+        }
+        else
+        {
+            Node cleaned = null, clean = null;
+            int  i;
+            for (i = 0; i < frames; i++, hand = hand.next)
+            {
+                if (!hand.dirty && clean == null) clean = hand;
+                if (hand.referenced)
+                {
+                    hand.referenced = false;
+                    hand.lastUse = now;
+                }
+                else if (now - hand.lastUse > window)
+                {
+                    if (!hand.dirty) break;
+                    writes++; // Write back the old dirty page
+                    hand.dirty = false;
+                    if (cleaned == null) cleaned = hand;
+                }
+            }
+            if (i == frames) // A whole lap found nothing
+                hand = cleaned != null ? cleaned : clean != null ? clean : hand;
+
+            temp = hand;
+            evict(address, temp);
+            index.remove(temp.page);
+            temp.page = page;
+            temp.dirty = write;
+            temp.referenced = true;
+        }
+        temp.lastUse = now;
+        index.put(page, temp);
+    }
+}
@@ -1,632 +1,671 @@
 import java.io.*;
 import java.util.*;
+import java.util.concurrent.ForkJoinPool;
+import java.util.concurrent.ForkJoinTask;
 /**
     @author Nicolas Leo
     CS 1550 Project 3
     
     Virtual Memory Simulator
-    This program simulates 4 VM page replacement algorithms: 
-        Optimal
-        Clock
-        First-In First-Out (FIFO)
-        Not Recently Used (NRU)
+    This program simulates 9 VM page replacement algorithms: 
+        Optimal                     (Opt.java)
+        Clock                       (Clock.java)
+        First-In First-Out (FIFO)   (Fifo.java)
+        Not Recently Used (NRU)     (Nru.java)
+        Least Recently Used (LRU)   (Lru.java)
+        WSClock                     (WsClock.java)
+        ARC                         (Arc.java)
+        2Q                          (TwoQueue.java)
+        Least Frequently Used (LFU) (Lfu.java)
+    compile (picks up the other .java files in this directory)
+    javac vmsim.java
     execution
-    java vmsim –n <numframes> -a <opt|clock|fifo|nru> [-r <refresh>] <tracefile>
+    java vmsim –n <numframes> -a <opt|clock|fifo|nru|lru|wsclock|arc|2q|lfu>
+               [-r <refresh>] [-w <window>] [-q|-v] <tracefile>
+                                  (-r: NRU, -w: WSClock working set window in
+                                   accesses, numframes if not given)
+                                  (-q: summary only, -v: every access too, the default)
+    options for any run
+        -s <pagesize>             page size, e.g. 4k (default), 2m, 4m, 1g
+        -tlb <entries>[,<ways>]   also model a TLB (fully associative if no ways)
+                                  & page table walks, reports hit rate & walk cost
+        -pt <2|4>                 page table levels for the walks (default 4)
+        -disk <access>,<page>[,<cpu>]
+                                  disk model: an I/O takes access + pages * page
+                                  us, cpu ns pass between accesses (default
+                                  5000,50,100). Reports stall time per fault.
+        -flush <every>,<pages>[,<ahead>[,<threshold>]]
+                                  background flusher (lru, clock or fifo, implies
+                                  -disk): every `every` accesses, clean up to
+                                  pages dirty pages among the next `ahead` frames
+                                  to be evicted (default frames/4), only if at
+                                  least threshold of them are dirty. Foreground
+                                  (eviction) & background writes are reported
+                                  apart.
+        -coalesce <pages>         most adjacent dirty pages per background write
+                                  (default 8)
+    options for single runs
+        -m <k> [-ws <taus>] [-o <file>]
+                                  every k accesses, write the window's faults,
+                                  writes, distinct pages & working set size for
+                                  each tau (a list, default k) to file (default
+                                  metrics.csv, binary if it ends in .bin)
+    java vmsim -n <maxframes> -a mrc [-s <pagesize>] <tracefile>
+                                  (LRU & OPT faults/writes for 1..maxframes as CSV)
+    java vmsim -p <tracefile>     (compares trace parsing speed)
+    java vmsim -c <tracefile> <out>   (converts to binary if out ends in .vmt,
+                                       to text otherwise, - for stdout)
+    Trace files ending in .gz are read directly, .vmt files are memory mapped.
+    A trace named gen:<spec> is generated as it's read (models uniform, zipf, hot,
+    loop & seq, phases joined by +, see TraceGen.java), e.g.
+    java vmsim -n 1024 -a lru -q gen:zipf:pages=65536,s=0.99,w=0.3+loop:pages=2048
+    java vmsim -c gen:uniform:pages=1e6,n=1e9 big.vmt
+
+    benchmark suite (every algorithm at 64-4096 frames on synthetic workloads &
+    swim.trace.gz if it's here, CSV of fault rates & accesses/s)
+    java vmsim -b [<baseline.csv>]    (saves the baseline if the file doesn't
+                                       exist, otherwise reports changed fault
+                                       counts & runs under 80% of its speed)
+
+    several processes (one per trace, pids in command line order)
+    java vmsim -n <numframes> -a <algorithm> [-i rr[:<quantum>]|time]
+               [-local [-quota <q1,q2,...>] | -pff <lo>,<hi>[,<window>]] <trace> <trace> ...
+        -i      interleaving: round robin, quantum accesses a turn (default 1), or
+                by the timestamp column of text traces
+        -local  local replacement, each process has a fixed quota of frames (the
+                frames split evenly unless given), global replacement if not set
+        -pff    local replacement with page fault frequency quotas (lru, clock or
+                fifo): each process starts with half its even share, every window
+                accesses (default 1000) a fault rate above hi takes a free frame,
+                one below lo gives one back. lo & hi are faults per access.
+    Per process accesses, faults & writes are printed after the totals.
+
+    approximate runs (SHARDS spatial sampling, see Shards.java; not with -m, -tlb
+    or several traces)
+        -sample <rate>            simulate only the pages a hash picks with
+                                  probability rate (e.g. 0.01) on frames * rate
+                                  frames; faults & writes are estimated with 95%
+                                  bounds. Works for single runs, sweeps & mrc.
+                                  Only LRU & OPT estimates are unbiased, the
+                                  others' +/- is just sampling noise (Shards.java)
+        -smax <pages>             mrc only: track at most this many pages (default
+                                  8192), lowering the rate as needed, so memory
+                                  stays the same however long the trace
+    java vmsim -n <maxframes> -a mrc -sample <rate> [-smax <pages>] <tracefile>
+                                  (estimated LRU faults for 1..maxframes with
+                                   bounds; -smax alone starts at rate 1)
+
+    sweep (every combination, run in parallel, results as CSV)
+    java vmsim -a clock,fifo,nru,opt -n 8,16,...,8192 [-r 100,1000] [-t <threads>] <tracefile>
+    Lists are comma separated. "..." continues the step set by the two values
+    before it (geometric if the 2nd is a multiple of the 1st, else arithmetic) up
+    to the value after it. -t defaults to one thread per core. Sweeps & OPT hold the
+    whole trace (or the sample) in memory, 9 bytes an access plus 4 for OPT's
+    next uses, so at most 2^31 - 1 accesses: sample longer traces. To compare fault
+    rates & throughput of every policy (time each one alone with -t 1):
+    java vmsim -a opt,lru,clock,wsclock,fifo,nru,arc,2q,lfu -n 64 -r 1000 -t 1 swim.trace
  */
 public class vmsim 
 {
-    private static int maccesses = 0, // Number of memory accesses
-                       faults    = 0, // Number of page faults
-                       writes    = 0; // Number of dirty pages written to disk
-    private static HashMap<Long, Node> PT;  // PT used int optimal algorithm
-    private static Node hand, // Used for the clock algorithm
-                        head, tail; // Used for linked list algorithms
-    
+    private static int pageShift = 12,              // log2 of the page size
+                       tlbEntries = 0, tlbWays = 0, // No TLB model if 0
+                       ptLevels = 4,
+                       coalesce = 8;                // Most pages in a background write
+    private static double[] flush = null,           // {every, pages, ahead, threshold}
+                            disk = null;            // {access us, page us, cpu ns}, no disk model if null
 
     public static void main(String[] args)
     {
-        String tracefile = null;
-        int refresh = 0, frames = 0;
-        if (args.length == 5)
-        {
-            frames = Integer.parseInt(args[1]);
-            tracefile = args[4];
-        } 
-        else if (args.length == 7)
+        String tracefile = null, algorithms = null, frameList = null, refreshList = "0", windowList = "0";
+        String tauList = null, metricsFile = "metrics.csv", interleave = "rr", quotaList = null;
+        List<String> traces = new ArrayList<String>();
+        double[] pff = null;
+        boolean local = false;
+        int    threads = 0, metricsWindow = 0, smax = 0;
+        double sample = 0;
+        boolean quiet = false;
+
+        try
         {
-            frames = Integer.parseInt(args[1]);
-            refresh = Integer.parseInt(args[5]);
-            tracefile = args[6];
-        } 
-        else 
+            for (int i = 0; i < args.length; i++)
+            {
+                switch (args[i].replace('\u2013', '-')) // The usage above has an en dash
+                {
+                    case "-p":
+                        parseBenchmark(args[i + 1]);
+                        return;
+                    case "-c":
+                        convert(args[i + 1], args[i + 2]);
+                        return;
+                    case "-b":
+                        Benchmark.run(i + 1 < args.length ? args[i + 1] : null);
+                        return;
+                    case "-n": frameList = args[++i]; break;
+                    case "-a": algorithms = args[++i]; break;
+                    case "-r": refreshList = args[++i]; break;
+                    case "-w": windowList = args[++i]; break;
+                    case "-s": pageShift = parsePageSize(args[++i]); break;
+                    case "-m": metricsWindow = Integer.parseInt(args[++i]); break;
+                    case "-ws": tauList = args[++i]; break;
+                    case "-o": metricsFile = args[++i]; break;
+                    case "-pt": ptLevels = Integer.parseInt(args[++i]); break;
+                    case "-tlb":
+                        String[] tlb = args[++i].split(",");
+                        tlbEntries = Integer.parseInt(tlb[0]);
+                        tlbWays = tlb.length > 1 ? Integer.parseInt(tlb[1]) : tlbEntries;
+                        break;
+                    case "-t": threads = Integer.parseInt(args[++i]); break;
+                    case "-i":
+                        interleave = args[++i];
+                        if (!interleave.matches("rr(:[1-9][0-9]*)?|time")) throw new IllegalArgumentException();
+                        break;
+                    case "-local": local = true; break;
+                    case "-quota": quotaList = args[++i]; local = true; break;
+                    case "-pff":
+                        String[] v = args[++i].split(",");
+                        pff = new double[] {Double.parseDouble(v[0]), Double.parseDouble(v[1]),
+                                            v.length > 2 ? Integer.parseInt(v[2]) : 1000};
+                        if (pff[0] >= pff[1] || pff[2] < 1) throw new IllegalArgumentException();
+                        local = true;
+                        break;
+                    case "-sample":
+                        sample = Double.parseDouble(args[++i]);
+                        if (!(sample > 0 && sample <= 1)) throw new IllegalArgumentException();
+                        break;
+                    case "-smax":
+                        smax = Integer.parseInt(args[++i]);
+                        if (smax < 1 || smax > 1 << 24) throw new IllegalArgumentException();
+                        break;
+                    case "-flush":
+                        String[] fl = args[++i].split(",");
+                        flush = new double[] {Integer.parseInt(fl[0]), Integer.parseInt(fl[1]),
+                                              fl.length > 2 ? Integer.parseInt(fl[2]) : 0,
+                                              fl.length > 3 ? Double.parseDouble(fl[3]) : 0};
+                        if (flush[0] < 1 || flush[1] < 0 || flush[2] < 0 || flush[3] < 0 || flush[3] > 1)
+                            throw new IllegalArgumentException();
+                        break;
+                    case "-coalesce":
+                        coalesce = Integer.parseInt(args[++i]);
+                        if (coalesce < 1) throw new IllegalArgumentException();
+                        break;
+                    case "-disk":
+                        String[] dk = args[++i].split(",");
+                        disk = new double[] {Double.parseDouble(dk[0]), Double.parseDouble(dk[1]),
+                                             dk.length > 2 ? Double.parseDouble(dk[2]) : 100};
+                        if (disk[0] < 0 || disk[1] < 0 || disk[2] < 0) throw new IllegalArgumentException();
+                        break;
+                    case "-q": quiet = true; break;
+                    case "-v": quiet = false; break;
+                    default:
+                        if (args[i].startsWith("-")) throw new IllegalArgumentException();
+                        traces.add(args[i]);
+                        tracefile = traces.get(0);
+                }
+            }
+            if (tracefile == null || algorithms == null || frameList == null || min(parseList(frameList)) < 1
+                || quotaList != null && min(parseList(quotaList)) < 1
+                || metricsWindow < 0 || tauList != null && min(parseList(tauList)) < 1
+                || (ptLevels != 2 && ptLevels != 4) || tlbEntries > 0 && tlbWays < 1 || tlbEntries < tlbWays
+                || (sample > 0 || smax > 0) && (traces.size() > 1 || metricsWindow > 0 || tlbEntries > 0)
+                || (flush != null || disk != null) && (traces.size() > 1 || sample > 0))
+                throw new IllegalArgumentException();
+        }
+        catch (RuntimeException e)
         {
             System.out.println("Invalid number of arguments");
             System.exit(0);
         }
 
-        if (args[3].equalsIgnoreCase("opt")) opt(tracefile, frames);
-        else if (args[3].equalsIgnoreCase("clock")) clock(tracefile, frames);
-        else if (args[3].equalsIgnoreCase("fifo")) fifo(tracefile, frames);  
-        else if (args[3].equalsIgnoreCase("nru")) nru(tracefile, frames,refresh);
-        else
-        {
-            System.out.println("Invalid algorithm. Exiting.");
-            System.exit(0);
-        }
+        int[] frames = parseList(frameList), refresh = parseList(refreshList),
+              window = parseList(windowList);
+        String[] names = algorithms.split(",");
 
-        // Print the results
-        System.out.printf("\nAlgorithm: %s\n", args[3].toUpperCase());
-        if(args.length == 7) 
-            System.out.printf("Refresh rate:     \t%,9d\n", refresh);
-        System.out.printf("Number of frames: \t%,9d\n", frames);
-        System.out.printf("Total memory accesses: \t%,9d\n", maccesses);
-        System.out.printf("Total page faults: \t%,9d\n", faults);
-        System.out.printf("Total writes to disk:\t%,9d\n", writes);
-        System.exit(0);
-    }
-    /**
-        Check the page table (PT) hash map for the given page. If found update referenced &
-        dirty (if necessary).
-        @param hexString Raw hexadecimal string read from the input file
-        @param page Page number
-        @param access Page access ('W' or 'R')
-        @return True if the given page is in the PT. False otherwise
-    */
-    private static boolean hasOptPage(long address, boolean dirty)
-    {
-        // Check the PT (hash map) for the given key (page number)
-        Node temp;
-        if((temp = PT.get(new Long(address >> 12))) != null)
+        if (metricsWindow > 0 && (traces.size() > 1 || names.length > 1 || frames.length > 1
+            || refresh.length > 1 || window.length > 1 || threads > 0 || names[0].equalsIgnoreCase("mrc")))
         {
-            System.out.printf("%#010x - HIT\n", address);
-            temp.referenced = true;
-            if(dirty) temp.dirty = true;
-            return true;
-        } 
-
-        return false;
-    }
-    /**
-        Optimal page replacement algorithm. On fault, evicts the page that will be used
-        farthest in the future (if it is used at all). 
-        @param fileName String of the trace file's name.
-        @param frames Number of frames in the PT
-    */
-    private static void opt(String fileName, int frames)
-    {
-        char access;
-        int  biggestAccess, listLen;
-        long page; 
-        LinkedList<Node> list;
-        Node node = null, farthestN = null;
-        PT = new HashMap<Long, Node>();
-        HashMap<Long, LinkedList<Node>> futures = new HashMap<Long, LinkedList<Node>>();
-
-        // head & tail defined statically and used only for reading ahead in the file, not 
-        // for the PT
-        Scanner sc = null;
-        try {sc = new Scanner(new File(fileName));}
-        catch (Exception e)
-        {
-            System.out.println("Error opening file. Exiting.");
+            System.out.println("-m only works for single runs. Exiting.");
             System.exit(0);
         }
-        
-        String  hexString;   
 
-        // Pre-process file
-        if(sc.hasNextLong(16))
+        if (names.length == 1 && names[0].equalsIgnoreCase("mrc"))
         {
-            hexString = sc.next(); 
-            page = Long.parseLong(hexString, 16);
-            access = sc.next().charAt(0);
-            head = new Node(page, access, maccesses);
-            maccesses++;
-
-            list = new LinkedList<Node>();
-            list.add(node);
-            futures.put(new Long(page>>12),list); 
+            if (sample > 0 || smax > 0)
+                Shards.mrc(tracefile, frames[frames.length - 1], pageShift, sample > 0 ? sample : 1,
+                    smax > 0 ? smax : 8192);
+            else
+                MissRatioCurve.run(tracefile, frames[frames.length - 1], pageShift);
+            System.exit(0);
         }
-        else return;  
-
-        node = head;
-        while(sc.hasNextLong(16)) 
+        for (String name : names)
         {
-            hexString = sc.next(); 
-            page = Long.parseLong(hexString, 16);
-            access = sc.next().charAt(0);
-            node.next = new Node(page, access, maccesses);
-            node = node.next;
-            maccesses++;
-
-            if((list = futures.get(new Long(page>>12))) != null) list.add(node); 
-            else 
+            if (Simulator.create(name, 1, 0) == null)
             {
-                list = new LinkedList<Node>();
-                list.add(node);
-                futures.put(new Long(page>>12),list); // Add page to the PT
-            } 
-        }
-
-        // Adding first page to PT. There's a fault
-        System.out.printf("%#010x - FAULT - no eviction\n", head.page);
-        listLen = faults = 1;
-        
-        PT.put(new Long(head.page >> 12), node); // Add page to PT
-        list = futures.get(head.page >> 12); // Remove entry from LL for this page
-        if(!list.isEmpty()) list.pop();
-        head = head.next;
-
-        while(head!=null && listLen < frames)
-        {
-            if(hasOptPage(head.page, head.dirty))
-            { 
-                list = futures.get(head.page >> 12);
-                if(!list.isEmpty()) list.pop();// Remove entry from LL for this page
-                head = head.next;
-                continue;
+                System.out.println("Invalid algorithm. Exiting.");
+                System.exit(0);
             }
-
-            System.out.printf("%#010x - FAULT - no eviction\n", head.page);
-            faults++; listLen++;
-
-            PT.put(new Long(head.page >> 12), head);// Add page to PT
-            list = futures.get(head.page >> 12); // Remove entry from LL for this page
-            if(!list.isEmpty()) list.pop();
-            head = head.next;
-        }   
-
-        while (head!=null)
-        {
-            // Read next address if page was updated.
-            if(hasOptPage(head.page, head.dirty))
-            {
-                list = futures.get(head.page >> 12);
-                if(!list.isEmpty()) list.pop();// Remove entry from LL for this page
-                head = head.next;
-            } 
-            else // Page wasn't found. FAULT
+            if (flush != null && flush[1] > 0) try { Simulator.create(name, 1, 0).upcoming(null); }
+            catch (UnsupportedOperationException e)
             {
-                // Evict the page that is used needed farthest in the future
-                faults++; 
-                biggestAccess = 0;
-
-                // Check each PTE for the one that's used farthest in the future
-                for (Map.Entry<Long, Node> entry : PT.entrySet()) 
-                {
-                    if((list = futures.get(entry.getKey()))!= null)
-                    {
-                        if((node = list.peek()) != null) 
-                        {    
-                            if(node.readNum > biggestAccess)
-                            { 
-                                biggestAccess = node.readNum; 
-                                farthestN = node; 
-                            }
-                        }
-                        else
-                        {
-                            farthestN = entry.getValue(); break;
-                        }
-                    }
-                    else // If list isn't in futures this page isn't used again
-                    {
-                        farthestN = entry.getValue(); break;
-                    }
-                } 
-
-                // Evict the farthest used
-                System.out.printf("%#010x - FAULT - evict %s (%#x)\n",
-                    head.page, farthestN.dirty ?"dirty": "clean", 
-                    farthestN.page >> 12 );
-                if(farthestN.dirty) writes++;
-
-                PT.remove(new Long(farthestN.page >> 12));
-                PT.put(new Long(head.page >> 12), head);
-
-                list = futures.get(head.page >> 12);
-                if(!list.isEmpty()) list.pop();// Remove entry from LL for this page
-                head = head.next;
+                System.out.println("The flusher needs lru, clock or fifo. Exiting.");
+                System.exit(0);
             }
-        }   
-    }
+        }
 
-    /**
-        Check the CIRCULAR page table (PT) for the given page. If found update referenced &
-        dirty (if necessary).
-        @param length Length of the linked list
-        @param hexString Raw hexadecimal string read from the input file
-        @param page Page number
-        @param access Page access ('W' or 'R')
-        @return True if the given page is in the PT. False otherwise
-    */
-    private static boolean hasCircularPage(int length, String hexString, long page, 
-        char access)
-     {
-        Node temp = hand;
-        for (int i = 0; i < length ; i++) 
+        if (traces.size() > 1)
+        {
+            String param = Simulator.paramName(names[0]);
+            multi(traces.toArray(new String[0]), names[0], frames[0],
+                "window".equals(param) ? window[0] : refresh[0], interleave, local,
+                quotaList == null ? null : parseList(quotaList), pff, quiet);
+        }
+        else if (names.length == 1 && frames.length == 1 && refresh.length == 1
+            && window.length == 1 && threads == 0 && sample > 0)
+        {
+            String param = Simulator.paramName(names[0]);
+            sampled(tracefile, names[0], frames[0], "window".equals(param) ? window[0] : refresh[0], sample);
+        }
+        else if (names.length == 1 && frames.length == 1 && refresh.length == 1
+            && window.length == 1 && threads == 0)
         {
-            if (temp.page == page)
+            String    param = Simulator.paramName(names[0]);
+            Simulator sim = create(names[0], frames[0], "window".equals(param) ? window[0] : refresh[0]);
+            if (metricsWindow > 0)
             {
-                System.out.printf("0x%s - HIT\n", hexString);
-                temp.referenced = true;
-                if(access == 'W') temp.dirty = true;
-                return true;  
+                int[] taus = parseList(tauList != null ? tauList : "" + metricsWindow);
+                sim.metrics = new Metrics(sim, metricsWindow, taus, metricsFile);
             }
-            temp = temp.next;
+            single(tracefile, sim, names[0], quiet);
         }
-        return false;
+        else
+            sweep(tracefile, names, frames, refresh, window, threads, sample);
+        System.exit(0);
     }
 
     /**
-        Clock algorithm. On fault, evicts the next unreferenced page. 
-        @param fileName String of the trace file's name.
-        @param frames Number of frames in the PT
+        Runs one simulation, printing every access (unless quiet) and then a summary.
     */
-    private static void clock(String fileName, int frames)
+    private static void single(String tracefile, Simulator sim, String name, boolean quiet)
     {
-        char    access;
-        int     listLen = 0;
-        long    page; 
+        String    param = Simulator.paramName(name);
+        AccessPrinter printer = quiet ? null : new AccessPrinter();
+        sim.events = printer;
 
-        Scanner sc = null;
-        try {sc = new Scanner(new File(fileName));}
-        catch (Exception e)
-        {
-            System.out.println("Error opening file. Exiting.");
-            System.exit(0);
-        }
-        String  hexString;   
+        long start = System.nanoTime();
+        sim.run(TraceReader.open(tracefile));
+        if (printer != null) printer.flush();
+        double seconds = (System.nanoTime() - start) / 1e9;
 
-        if(sc.hasNextLong(16))
+        // Print the results
+        System.out.printf("\nAlgorithm: %s\n", name.toUpperCase());
+        if ("refresh".equals(param))
+            System.out.printf("Refresh rate:     \t%,9d\n", ((Nru) sim).refresh);
+        if ("window".equals(param))
+            System.out.printf("Window:           \t%,9d\n", ((WsClock) sim).window);
+        System.out.printf("Number of frames: \t%,9d\n", sim.frames);
+        if (pageShift != 12)
+            System.out.printf("Page size (KB):   \t%,9d\n", 1L << (pageShift - 10));
+        System.out.printf("Total memory accesses: \t%,9d\n", sim.maccesses);
+        System.out.printf("Total page faults: \t%,9d\n", sim.faults);
+        System.out.printf("Total writes to disk:\t%,9d\n", sim.writes);
+        System.out.printf("Simulation time (s):\t%,9.3f\n", seconds);
+        System.out.printf("Accesses per second:\t%,9.0f\n", sim.maccesses / seconds);
+        if (sim.tlb != null)
         {
-            // Read the 1st address & access from the file
-            hexString = sc.next(); 
-            page = Long.parseLong(hexString, 16);
-            page >>= 12;
-            access = sc.next().charAt(0);
-           
-            System.out.printf("0x%s: FAULT - no eviction\n", hexString);
-
-            maccesses = listLen = faults = 1;
-            head = new Node(page, access); // Store page # & access
-
-            hand = tail = head; head.next = head;
+            System.out.printf("TLB hit rate (%%): \t%9.3f\n", 100 * sim.tlb.hitRate());
+            System.out.printf("Page walk references:\t%,9d\n", sim.tlb.walkRefs);
+            System.out.printf("Average walk cost:\t%9.3f\n", sim.tlb.walkCost());
         }
-        else return;   
-
-        // PT is not full. 
-        while(sc.hasNextLong(16) && listLen < frames)
-        {
-            maccesses++;
-            hexString = sc.next(); 
-            page = Long.parseLong(hexString, 16);
-            page >>= 12;
-            access = sc.next().charAt(0);
-
-
-            if(hasCircularPage(listLen, hexString, page, access)) continue;
-
-            System.out.printf("0x%s: FAULT - no eviction\n", hexString);
-            faults++; listLen++;
-
-            // Add page to the PT
-            tail.next = new Node(page, access);
-            tail = tail.next; tail.next = head;
-        }   
+        if (sim.flusher != null) sim.flusher.report();
+    }
 
-        while (sc.hasNextLong(16))
-        {
-            maccesses++;
-            hexString = sc.next(); 
-            page = Long.parseLong(hexString, 16);
-            page >>= 12;
-            access = sc.next().charAt(0);
-
-            // Read next address if page was updated.
-            if(hasCircularPage(listLen, hexString, page, access)) {}
-            else // Page wasn't found. FAULT
-            {
-                faults++; 
-                while (true)
-                {
-                    // Look for the next unreferenced page, marking referenced pages as
-                    // unreferenced until one is found. 
-                    if (!hand.referenced)
-                    {
-                        System.out.printf("0x%s: FAULT - evict %s (%#x)\n", hexString,
-                            hand.dirty ?"dirty": "clean", hand.page);
-                        if(hand.dirty) writes++;
-                        hand.page = page;
-                        hand.referenced = true;
-                        hand.dirty = access == 'W'? true: false; 
-                        break; 
-                    } 
-                    else 
-                    {
-                        hand.referenced = false; hand = hand.next;
-                    }
-                }
-            }
-        }   
+    /**
+        Estimates one simulation from a sample of the pages (see Shards) & prints the
+        estimates with their 95% bounds, or with the spread of the groups for
+        algorithms whose estimates are biased. The rate is nudged so the frames
+        shrink to a whole number.
+    */
+    private static void sampled(String tracefile, String name, int frames, int param, double rate)
+    {
+        Shards    shards = new Shards(Math.max(1, Math.round(frames * rate)) / (double) frames);
+        Simulator sim = create(name, shards.scale(frames), shards.scale(param));
+        Shards.Estimate estimate = shards.new Estimate(pageShift);
+        Shards.Sample   sample = shards.sample(TraceReader.open(tracefile), pageShift);
+        sim.events = estimate;
+
+        long start = System.nanoTime();
+        sim.run(sample);
+        double seconds = (System.nanoTime() - start) / 1e9;
+
+        System.out.printf("\nAlgorithm: %s (sampled)\n", name.toUpperCase());
+        if (param > 0 && "refresh".equals(Simulator.paramName(name)))
+            System.out.printf("Refresh rate:     \t%,9d\n", param);
+        if (param > 0 && "window".equals(Simulator.paramName(name)))
+            System.out.printf("Window:           \t%,9d\n", param);
+        System.out.printf("Number of frames: \t%,9d\n", frames);
+        if (pageShift != 12)
+            System.out.printf("Page size (KB):   \t%,9d\n", 1L << (pageShift - 10));
+        System.out.printf("Sample rate (%%):  \t%9.3f\n", 100 * shards.rate());
+        System.out.printf("Sampled frames:   \t%,9d\n", sim.frames);
+        System.out.printf("Sampled accesses: \t%,9d\n", sim.maccesses);
+        System.out.printf("Total memory accesses: \t%,9d\n", sample.total);
+        String bounds = Shards.biased(name) ? "spread, biased" : "95%";
+        System.out.printf("Total page faults: \t%,9.0f +/- %,.0f (%s)\n", estimate.faults(),
+            estimate.faultError(), bounds);
+        System.out.printf("Total writes to disk:\t%,9.0f +/- %,.0f (%s)\n", estimate.writes(),
+            estimate.writeError(), bounds);
+        System.out.printf("Simulation time (s):\t%,9.3f\n", seconds);
+        System.out.printf("Accesses per second:\t%,9.0f\n", sample.total / seconds);
+        if (Shards.biased(name))
+            System.out.printf("%s isn't a stack algorithm: shrinking the trace & frames changes how it\n"
+                + "faults, so the estimates are biased & +/- is only their sampling noise.\n",
+                name.toUpperCase());
+        if (sim.frames < Shards.MIN_FRAMES)
+            System.out.printf("Under %d sampled frames the estimates can be biased, raise -sample.\n",
+                Shards.MIN_FRAMES);
     }
 
     /**
-        First-in-first-out (FIFO) algorithm. On fault, evicts the oldest entry in the PT.
-        @param fileName String of the trace file's name.
-        @param frames Number of frames in the PT
+        Replays several traces as processes sharing the frames, then prints the
+        totals & per process stats.
+        @param quotas Frames of each process for -local, null to split them evenly
+        @param pff {lo, hi, window} for PFF quotas, null for fixed ones
     */
-    private static void fifo(String fileName, int frames)
+    private static void multi(String[] files, String name, int frames, int param,
+        String interleave, boolean local, int[] quotas, double[] pff, boolean quiet)
     {
-        char    access;
-        int     listLen;
-        long    page; 
+        int           k = files.length;
+        MultiProcess  mp = new MultiProcess(files, interleave);
+        AccessPrinter printer = quiet ? null : new AccessPrinter();
+        Simulator[]   sims = new Simulator[local ? k : 1];
+        int           used = 0;
 
-        Scanner sc = null;
-        try {sc = new Scanner(new File(fileName));}
-        catch (Exception e)
+        if (quotas != null && quotas.length != k || pff != null && !create(name, 2, param).release())
         {
-            System.out.println("Error opening file. Exiting.");
+            System.out.println(quotas != null && quotas.length != k
+                ? "Need one quota per trace. Exiting." : "PFF needs lru, clock or fifo. Exiting.");
             System.exit(0);
         }
-        String  hexString;        
 
-        if(sc.hasNextLong(16))
+        long start = System.nanoTime();
+        if (!local)
         {
-            // Read the 1st address & access from the file
-            hexString = sc.next(); 
-            page = Long.parseLong(hexString, 16);
-            page >>= 12;
-            access = sc.next().charAt(0);
-           
-            System.out.printf("0x%s: FAULT - no eviction\n", hexString);
-
-            maccesses = listLen = faults = 1;
-            head = new Node(page, access); // Store page # & access
-
-            tail = head;
+            sims[0] = create(name, frames, param);
+            mp.runGlobal(sims[0], printer);
+            used = frames;
         }
-        else return;   
-
-        // PT is not full. 
-        while(sc.hasNextLong(16) && listLen < frames)
+        else
         {
-            maccesses++;
-            hexString = sc.next(); 
-            page = Long.parseLong(hexString, 16);
-            page >>= 12;
-            access = sc.next().charAt(0);
-
-            if(hasPage(hexString, page, access)) continue;
-
-            System.out.printf("0x%s: FAULT - no eviction\n", hexString);
-            faults++; listLen++;
-
-            // Add page to the PT
-            tail.next = new Node(page, access);
-            tail = tail.next;
-        }     
+            for (int p = 0; p < k; p++)
+            {
+                int q = quotas != null ? quotas[p] : Math.max(1, frames / k / (pff != null ? 2 : 1));
+                sims[p] = create(name, q, param);
+                sims[p].events = printer;
+                used += q;
+            }
+            if (pff == null) mp.runLocal(sims, 0, 0, 0, 1);
+            else mp.runLocal(sims, Math.max(0, frames - used), pff[0], pff[1], (int) pff[2]);
+            used = Math.max(used, frames);
+        }
+        if (printer != null) printer.flush();
+        double seconds = (System.nanoTime() - start) / 1e9;
 
-        while (sc.hasNextLong(16)) // read until the EOF
+        long accesses = 0, faults = 0, writes = 0;
+        for (Simulator sim : sims)
         {
-            maccesses++;
-
-            // Read the next address & access from the file
-            hexString = sc.next(); 
-            page = Long.parseLong(hexString, 16);
-            page >>= 12;
-            access = sc.next().charAt(0);
+            accesses += sim.maccesses;
+            faults += sim.faults;
+            writes += sim.writes;
+        }
+        System.out.printf("\nAlgorithm: %s (%s replacement%s)\n", name.toUpperCase(),
+            local ? "local" : "global", pff != null ? ", PFF quotas" : "");
+        System.out.printf("Processes:        \t%,9d\n", k);
+        System.out.printf("Number of frames: \t%,9d\n", used);
+        System.out.printf("Total memory accesses: \t%,9d\n", accesses);
+        System.out.printf("Total page faults: \t%,9d\n", faults);
+        System.out.printf("Total writes to disk:\t%,9d\n", writes);
+        System.out.printf("Simulation time (s):\t%,9.3f\n", seconds);
+        mp.report(local);
+    }
 
-            // Read next address if page was updated.
-            if(hasPage(hexString, page, access))  {} 
-            else // Page wasn't found. FAULT
-            {
-                faults++;
-                // Evict the oldest PTE. 
-                System.out.printf("0x%s - FAULT - evict %s (%#x)\n", hexString,
-                            head.dirty ?"dirty": "clean", head.page);
-                if(head.dirty) writes++;
-                tail.next = head; tail = head; head = head.next; tail.next = null; 
-                tail.page = page; tail.referenced = true;
-                tail.dirty = access == 'W'? true: false; 
-            }
+    // Creates a simulator with the page size & TLB options applied
+    private static Simulator create(String name, int frames, int param)
+    {
+        Simulator sim = Simulator.create(name, frames, param);
+        sim.pageShift = pageShift;
+        if (tlbEntries > 0) sim.tlb = new Tlb(tlbEntries, tlbWays, ptLevels, pageShift);
+        if (flush != null || disk != null)
+        {
+            double[] f = flush != null ? flush : new double[] {1, 0, 0, 0};
+            double[] d = disk != null ? disk : new double[] {5000, 50, 100};
+            sim.flusher = new Flusher(sim, (int) f[0], (int) f[1], (int) f[2], f[3], coalesce,
+                d[0], d[1], d[2] / 1000);
         }
+        return sim;
     }
 
     /**
-        Not-Recently-Used (NRU) algorithm. Evicts lowest based on classifications 0-3.
-        Class 0: not referenced, clean
-        Class 1: not referenced, dirty
-        Class 2: referenced, clean
-        Class 3: referenced, dirty
-        Also periodically sets all PTE's referenced bit to false;
-        @param fileName String of the trace file's name.
-        @param frames Number of frames in the PT
-        @param refresh How many cycles to wait before resetting the referenced bits to false
+        Parses a page size like 4096, 4k, 2m or 1g (a power of 2, at least 4k).
+        @return log2 of the size
     */
-    private static void nru(String fileName, int frames, int refresh)
+    private static int parsePageSize(String size)
     {
-        char access;
-        int  classification = 0, listLen = 0, lowestFound, reads = 0;
-        long page; 
-        
-        Node    temp, lowest = null, resume = null; // head & tail defined statically
-        Scanner sc = null;
-        try {sc = new Scanner(new File(fileName));}
-        catch (Exception e)
-        {
-            System.out.println("Error opening file. Exiting.");
-            System.exit(0);
-        }
-        String  hexString;
-        
-        if(sc.hasNextLong(16))
-        {
-            // Read the 1st address & access from the file
-            hexString = sc.next(); 
-            page = Long.parseLong(hexString, 16);
-            page >>= 12;
-            access = sc.next().charAt(0);
-           
-            System.out.printf("0x%s - FAULT - no eviction\n", hexString);
-
-            reads = maccesses = listLen = faults = 1;
-            head = new Node(page, access); // Store page # & access
-
-            tail = head;
-        }
-        else return;
+        String s = size.toLowerCase();
+        long   unit = s.endsWith("k") ? 1 << 10 : s.endsWith("m") ? 1 << 20 : s.endsWith("g") ? 1 << 30 : 1;
+        long   bytes = Long.parseLong(unit == 1 ? s : s.substring(0, s.length() - 1)) * unit;
+        if (bytes < 4096 || Long.bitCount(bytes) != 1) throw new IllegalArgumentException();
+        return Long.numberOfTrailingZeros(bytes);
+    }
 
-        // PT is not full. 
-        while(sc.hasNextLong(16) && listLen < frames)
-        {
-            if (reads >= refresh) // Set all referenced bits to false & reset read count
+    /**
+        Runs every (algorithm, frames, refresh or window) combination on a
+        work-stealing pool. The trace is decoded once & shared. Prints one CSV row
+        per simulation, in the order the combinations were listed; the total time
+        goes to stderr.
+        With a sample rate, each simulation runs on the sampled pages with its frames
+        (& refresh or window) shrunk by the rate. The faults & writes columns are then
+        estimates, followed by the sampled frames, the 95% bounds & whether the
+        algorithm's estimates are biased (1: the bounds are only sampling noise).
+        @param threads Pool size, 0 for one thread per core
+        @param rate Fraction of the pages to sample, 0 to simulate every access
+    */
+    private static void sweep(String tracefile, String[] names, int[] frames, int[] refresh,
+        int[] window, int threads, double rate)
+    {
+        Shards        shards = rate > 0 ? new Shards(rate) : null;
+        Shards.Sample sample = shards != null ? shards.sample(TraceReader.open(tracefile), pageShift) : null;
+        final Trace trace = sample != null ? Trace.read(sample) : Trace.read(tracefile);
+        final List<Simulator> sims = new ArrayList<Simulator>();
+        final List<String>    labels = new ArrayList<String>();
+        List<Shards.Estimate> estimates = new ArrayList<Shards.Estimate>();
+
+        for (String name : names)
+            for (int f : frames)
             {
-                reads = 0;
-                temp = head;
-                while (temp != null)
+                String param = Simulator.paramName(name);
+                int[]  values = "refresh".equals(param) ? refresh
+                              : "window".equals(param) ? window : new int[] {0};
+                for (int v : values)
                 {
-                    temp.referenced = false;
-                    temp = temp.next;
+                    if ("window".equals(param) && v <= 0) v = f;
+                    labels.add(name.toLowerCase() + "," + f + "," + v);
+                    if (shards == null)
+                    {
+                        sims.add(create(name, f, v));
+                        continue;
+                    }
+                    Simulator sim = create(name, shards.scale(f), shards.scale(v));
+                    estimates.add(shards.new Estimate(pageShift));
+                    sim.events = estimates.get(estimates.size() - 1);
+                    sims.add(sim);
                 }
             }
 
-            reads++; maccesses++;
-            hexString = sc.next(); 
-            page = Long.parseLong(hexString, 16);
-            page >>= 12;
-            access = sc.next().charAt(0);
-
-            if(hasPage(hexString, page, access)) continue;
-
-            System.out.printf("0x%s - FAULT - no eviction\n", hexString);
-            faults++; listLen++;
-
-            // Add page to the PT
-            tail.next = new Node(page, access);
-            tail = tail.next;
-        }    
-
-        resume = tail;
-
-        while (sc.hasNextLong(16)) // PT is full. Read until the EOF
+        final double[] seconds = new double[sims.size()];
+        List<ForkJoinTask<?>> tasks = new ArrayList<ForkJoinTask<?>>();
+        for (int i = 0; i < sims.size(); i++)
         {
-            if (reads >= refresh) // Set all referenced bits to false & reset read count
+            final int job = i;
+            tasks.add(ForkJoinTask.adapt(new Runnable()
             {
-                reads = 0;
-                temp = head;
-                while (temp != null)
+                public void run()
                 {
-                    temp.referenced = false;
-                    temp = temp.next;
+                    long start = System.nanoTime();
+                    sims.get(job).run(trace);
+                    seconds[job] = (System.nanoTime() - start) / 1e9;
                 }
-            }
+            }));
+        }
 
-            // Read the next address & access from the file
-            reads++; maccesses++;
-            hexString = sc.next(); 
-            page = Long.parseLong(hexString, 16);
-            page >>= 12;
-            access = sc.next().charAt(0);
+        ForkJoinPool pool = threads > 0 ? new ForkJoinPool(threads) : new ForkJoinPool();
+        long start = System.nanoTime();
+        for (ForkJoinTask<?> task : tasks) pool.execute(task);
+        for (ForkJoinTask<?> task : tasks) task.join();
+        double total = (System.nanoTime() - start) / 1e9;
+        pool.shutdown();
+
+        StringBuilder out = new StringBuilder("algorithm,frames,param,accesses,faults,writes,fault_rate,seconds,accesses_per_s");
+        out.append(tlbEntries > 0 ? ",tlb_hit_rate,walk_refs,walk_cost" : "");
+        out.append(flush != null || disk != null ? ",bg_writes,bg_ios,write_stall_s,stall_s" : "");
+        out.append(shards != null ? ",sampled_frames,faults_err,writes_err,biased\n" : "\n");
+        for (int i = 0; i < sims.size(); i++)
+        {
+            Simulator       sim = sims.get(i);
+            Shards.Estimate est = shards != null ? estimates.get(i) : null;
+            long   accesses = sample != null ? sample.total : sim.maccesses;
+            double faults = est != null ? est.faults() : sim.faults;
+            double writes = est != null ? est.writes() : sim.writes;
+            out.append(labels.get(i)).append(',').append(accesses).append(',')
+               .append(Math.round(faults)).append(',').append(Math.round(writes)).append(',')
+               .append(String.format(Locale.ROOT, "%.6f,%.3f,%.0f", faults / accesses, seconds[i],
+                   accesses / seconds[i]));
+            if (sim.tlb != null)
+                out.append(String.format(Locale.ROOT, ",%.6f,%d,%.3f", sim.tlb.hitRate(), sim.tlb.walkRefs,
+                    sim.tlb.walkCost()));
+            if (sim.flusher != null)
+                out.append(String.format(Locale.ROOT, ",%d,%d,%.3f,%.3f", sim.flusher.written,
+                    sim.flusher.ios, sim.flusher.writeStall / 1e6, sim.flusher.stall / 1e6));
+            if (est != null)
+                out.append(String.format(Locale.ROOT, ",%d,%.0f,%.0f,%d", sim.frames, est.faultError(),
+                    est.writeError(), Shards.biased(labels.get(i).split(",")[0]) ? 1 : 0));
+            out.append('\n');
+        }
+        System.out.print(out);
+        System.err.printf("%d simulations on %d threads: %.3f s (%.3f s of work)\n",
+            sims.size(), pool.getParallelism(), total, sum(seconds));
+    }
 
+    private static double sum(double[] a)
+    {
+        double s = 0;
+        for (double x : a) s += x;
+        return s;
+    }
 
-            // Check the PT for page, if found update referenced & dirty (if necessary)
-            if(hasPage(hexString, page, access)) {}
-            else // Page wasn't found. FAULT
+    /**
+        Parses "8,16,...,8192" style lists. "..." repeats the step between the two
+        values before it (a ratio if the 2nd is a multiple of the 1st, else a
+        difference) until the value after it.
+    */
+    private static int[] parseList(String list)
+    {
+        String[]      parts = list.split(",");
+        List<Integer> values = new ArrayList<Integer>();
+
+        for (int i = 0; i < parts.length; i++)
+        {
+            if (!parts[i].trim().equals("..."))
             {
-                faults++;
-                temp = resume.next == null? head: resume.next;
-                lowest = temp; // Keep track of the lowest PTE in order to evict
-                lowestFound = 4; 
-
-                // Search PT in circular manner to avoid leaving some entries untouched
-                // Evict the lowest class. Immediately evict class 0.
-                while (true)
-                {
-                    // Classify the current page
-                    if (!temp.referenced && !temp.dirty) // Class 0, immediate eviction
-                    {
-                        System.out.printf("0x%s - FAULT - evict clean (%#x)\n", 
-                            hexString, temp.page);
-                        // Replace current page with new page contents. 
-                        temp.page = page;
-                        temp.dirty = access == 'W'? true: false; 
-                        temp.referenced = true;
-                        resume = temp; // Start the search next time from here
-                        break;
-                    }                   
+                values.add(Integer.parseInt(parts[i].trim()));
+                continue;
+            }
+            int  k = values.size();
+            long a = values.get(k - 2), b = values.get(k - 1), end = Integer.parseInt(parts[i + 1].trim());
+            boolean ratio = a > 0 && b > a && b % a == 0;
+            if (b == a) throw new IllegalArgumentException();
+            for (long v = ratio ? b * (b / a) : 2 * b - a; (ratio || b > a) ? v < end : v > end;
+                 v = ratio ? v * (b / a) : v + (b - a))
+                values.add((int) v);
+        }
 
-                    else if (!temp.referenced && temp.dirty) classification = 1;
-                    else if (temp.referenced && !temp.dirty) classification = 2;
-                    else if (temp.referenced && temp.dirty) classification = 3;
+        int[] result = new int[values.size()];
+        for (int i = 0; i < result.length; i++) result[i] = values.get(i);
+        return result;
+    }
 
-                    if(classification <= lowestFound) 
-                    {
-                        lowestFound = classification; 
-                        lowest = temp; 
-                    }
+    // Smallest value of a parsed list
+    private static int min(int[] values)
+    {
+        int m = Integer.MAX_VALUE;
+        for (int v : values) m = Math.min(m, v);
+        return m;
+    }
 
-                    if (temp == resume) 
-                    {   // Reached the last entry in the PT, evict the lowest
-                        System.out.printf("0x%s - FAULT - evict %s (%#x)\n", hexString,
-                            lowest.dirty ?"dirty": "clean", lowest.page);
-                        // Replace current page with new page contents. 
-                        if(lowest.dirty) writes++;
-                        lowest.page = page;
-                        lowest.dirty = access == 'W'? true: false; 
-                        lowest.referenced = true;
-                        resume = lowest;
-                        break;
-                    }
-                    else temp = temp.next == null? head: temp.next; 
-                }
-            }
+    private static void convert(String from, String to)
+    {
+        try
+        {
+            long n = VmtTraceReader.convert(from, to);
+            (to.equals("-") ? System.err : System.out).printf("Converted %,d records to %s\n", n, to);
+        }
+        catch (IOException e)
+        {
+            System.out.println("Error writing file. Exiting.");
         }
     }
 
     /**
-        Check the page table (PT) for the given page. If found update referenced & 
-        dirty (if necessary).
-        @param hexString Raw hexadecimal string read from the input file
-        @param page Page number
-        @param access Page access ('W' or 'R')
-        @return True if the given page is in the PT. False otherwise
+        Reads the whole trace with Scanner (how the simulators used to) and with
+        TraceReader, and prints records/s for both. Scanner can't read .vmt files,
+        those (& generated traces) only time TraceReader.
+        @param fileName String of the trace file's name.
     */
-    private static boolean hasPage(String hexString, long page, char access)
+    private static void parseBenchmark(String fileName)
     {
-        Node temp = head;
-        while (temp != null)
+        long    scanned = 0, parsed = 0, check = 0, start;
+        double  scanner = 0, reader;
+        boolean text = !fileName.endsWith(VmtTraceReader.EXTENSION) && !fileName.startsWith(TraceGen.PREFIX);
+
+        start = System.nanoTime();
+        if (text) try
         {
-            if (temp.page == page)
+            InputStream in = new FileInputStream(fileName);
+            if (fileName.endsWith(".gz")) in = new java.util.zip.GZIPInputStream(in);
+            Scanner sc = new Scanner(in);
+            while (sc.hasNextLong(16))
             {
-                System.out.printf("0x%s - HIT\n", hexString);
-                temp.referenced = true;
-                if(access == 'W') temp.dirty = true; 
-                return true;  
+                check += Long.parseLong(sc.next(), 16) >> 12;
+                if (sc.next().charAt(0) == 'W') check++;
+                scanned++;
             }
-            temp = temp.next;
+            sc.close();
         }
-        return false;
-    }
-
-    // Node class used for linked lists in NRU & clock. 
-    private static class Node 
-    {
-        int readNum; // Used in Optimal algorithm to keep track when this page is seen
-        long page;
-        boolean dirty, referenced = true;
-        Node next   = null;   // Used for traversing as a normal linked list
+        catch (IOException e)
+        {
+            System.out.println("Error opening file. Exiting.");
+            System.exit(0);
+        }
+        scanner = (System.nanoTime() - start) / 1e9;
 
-        private Node(long p, char a)
+        start = System.nanoTime();
+        TraceReader tr = TraceReader.open(fileName);
+        while (tr.next())
         {
-            page = p;
-            dirty = a == 'W'? true: false;
+            check -= tr.address >> 12;
+            if (tr.write) check--;
+            parsed++;
         }
-        private Node(long p, char a, int r)
+        tr.close();
+        reader = (System.nanoTime() - start) / 1e9;
+
+        System.out.printf("Records:    \t%,13d\n", parsed);
+        if (!text)
         {
-            page = p;
-            dirty = a == 'W'? true: false;
-            readNum = r; 
+            System.out.printf("TraceReader:\t%,13.0f records/s\n", parsed / reader);
+            return;
         }
+        System.out.printf("Scanner:    \t%,13.0f records/s\n", scanned / scanner);
+        System.out.printf("TraceReader:\t%,13.0f records/s (%.1fx)\n", parsed / reader,
+            scanner / reader);
+        if (scanned != parsed || check != 0) System.out.println("Readers disagree!");
     }
-}
\ No newline at end of file
+}
@@ -17,6 +17,7 @@
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 
 //size of a disk block
 #define	BLOCK_SIZE 512
@@ -104,6 +105,103 @@ int num_dir = 0;
 int fileindex = 0;
 int directory_num = 0;
 
+// Copies of the root & of the last directory block read. readdir leaves the
+// directory it listed here, so the getattr that follows for every entry of an
+// 'ls -l' is answered without opening .disk again. Writes go through
+// open_disk(), which empties it, & a changed mtime on .disk empties it too.
+cs1550_root_directory cached_root;
+cs1550_directory_entry cached_dir;
+int root_cached = 0;
+long cached_block = -1;	// Block of cached_dir, -1 if none
+struct timespec cached_mtime;	// .disk's mtime when the cache was checked
+
+static void drop_cache(void)
+{
+	root_cached = 0;
+	cached_block = -1;
+}
+
+// Opens .disk for writing. Everything cached from it is about to go stale
+static FILE *open_disk(void)
+{
+	drop_cache();
+	return fopen(".disk", "r+b");
+}
+
+// Empties the cache if .disk was written since it was filled (by another
+// process, or replaced by hand). Returns -1 if there's no .disk
+static int check_cache(void)
+{
+	struct stat st;
+	if (stat(".disk", &st) != 0)
+	{
+		drop_cache();
+		return -1;
+	}
+	if (st.st_mtim.tv_sec != cached_mtime.tv_sec ||
+		st.st_mtim.tv_nsec != cached_mtime.tv_nsec)
+	{
+		drop_cache();
+		cached_mtime = st.st_mtim;
+	}
+	return 0;
+}
+
+// Reads the root into root & num_dir, from the cache if it can.
+// Returns -1 if there's no .disk
+static int read_root(void)
+{
+	if (check_cache() != 0) return -1;
+	if (!root_cached)
+	{
+		FILE *f = fopen(".disk", "rb");
+		if (f == NULL) return -1;
+		if (fread(&cached_root, 1, BLOCK_SIZE, f) != BLOCK_SIZE)
+			memset(&cached_root, 0, BLOCK_SIZE);
+		fclose(f);
+		root_cached = 1;
+	}
+	root = cached_root;
+	num_dir = root.nDirectories;
+	return 0;
+}
+
+// Reads the directory at block into de, from the cache if it can.
+// Returns -1 if there's no .disk
+static int read_dir(long block)
+{
+	if (check_cache() != 0) return -1;
+	if (cached_block != block)
+	{
+		FILE *f = fopen(".disk", "rb");
+		if (f == NULL) return -1;
+		fseek(f, BLOCK_SIZE*block, SEEK_SET);
+		if (fread(&cached_dir, 1, BLOCK_SIZE, f) != BLOCK_SIZE)
+			memset(&cached_dir, 0, BLOCK_SIZE);
+		fclose(f);
+		cached_block = block;
+	}
+	de = cached_dir;
+	return 0;
+}
+
+// Fills st for a file of the given size, or for a directory if size < 0
+static void fill_stat(struct stat *st, long size)
+{
+	memset(st, 0, sizeof(struct stat));
+	if (size < 0)
+	{
+		st->st_mode = S_IFDIR | 0755;
+		st->st_nlink = 2;
+	}
+	else
+	{
+		st->st_mode = S_IFREG | 0666;
+		st->st_nlink = 1;
+		st->st_size = size;
+	}
+}
+
 /*
  * Called whenever the system wants to know the file attributes, including
  * simply whether the file exists or not. 
@@ -133,12 +231,8 @@ static int cs1550_getattr(const char *path, struct stat *stbuf)
 	if((len = strlen(directory)) == 0 || len > MAX_FILENAME) 
 		return -ENOENT;
 
-	disk = fopen(".disk", "rb");
-	fread(&root, 1, BLOCK_SIZE, disk);
-	num_dir = root.nDirectories;
-
 	// Return no entry if no directories made yet
-	if(num_dir == 0) return -ENOENT; 
+	if(read_root() != 0 || num_dir == 0) return -ENOENT; 
 
 	//Check if name is subdirectory
 	if(strlen(filename) == 0 && strlen(extension) == 0)
@@ -149,9 +243,7 @@ static int cs1550_getattr(const char *path, struct stat *stbuf)
 		{ 
 			if(strcmp(root.directories[i].dname, directory) == 0)
 			{
-				stbuf->st_mode = S_IFDIR | 0755;
-				stbuf->st_nlink = 2;
-				fclose(disk);
+				fill_stat(stbuf, -1);
 				return 0;//no error
 			}
 		}
@@ -172,10 +264,8 @@ static int cs1550_getattr(const char *path, struct stat *stbuf)
 				break;
 			}
 
-		if(nStartBlock > -1)
+		if(nStartBlock > -1 && read_dir(nStartBlock) == 0)
 		{
-			fseek(disk, BLOCK_SIZE*nStartBlock, SEEK_SET);
-			fread(&de, 1, BLOCK_SIZE, disk);
 			max = de.nFiles;
 			for(i = 0; i < max; i++)
 			{ 
@@ -183,25 +273,26 @@ static int cs1550_getattr(const char *path, struct stat *stbuf)
 				   strcmp(de.files[i].fext, extension) == 0)
 				{
 					//regular file, probably want to be read & write
-					stbuf->st_mode = S_IFREG | 0666; 
-					stbuf->st_nlink = 1; //file links
-					stbuf->st_size = de.files[i].fsize;
+					fill_stat(stbuf, de.files[i].fsize);
 					// for write()
 					fileindex = i;
-					fclose(disk);
 					return 0; // no error						
 				}
 			}
 		}
 	}
 
-	fclose(disk);
 	return -ENOENT; //Else return that path doesn't exist
 }
 
 /* 
  * Called whenever the contents of a directory are desired. Could be from an 
  * 'ls' or could even be when a user hits TAB to do autocompletion
+ *
+ * Every entry comes with its full stat (mode, size, nlink) from the block
+ * already read, and with the offset of the entry after it (. is 0, .. is 1,
+ * then the names), so when filler says the buffer is full FUSE calls again
+ * with that offset and the listing picks up where it stopped.
  */
 static int cs1550_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
 			 off_t offset, struct fuse_file_info *fi)
@@ -209,14 +300,8 @@ static int cs1550_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
 	//Since we're building with -Wall (all warnings reported) we need
 	//to "use" every parameter, so let's just cast them to void to
 	//satisfy the compiler
-	(void) offset;
 	(void) fi;
 
-	//the filler function allows us to add entries to the listing
-	//read the fuse.h file for a description (in the ../include dir)
-	filler(buf, ".", NULL, 0);
-	filler(buf, "..", NULL, 0);
-
 	// Zero out the string
 	directory[0] = '\0'; 
 	char subdirectory[24]; subdirectory[0]='\0';
@@ -228,56 +313,56 @@ static int cs1550_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
 	if(strlen(subdirectory)>0 || 
 		strlen(directory) > MAX_FILENAME) return -ENOENT;
 
-	// Check reading the root directory
-	if (strcmp(path, "/") == 0)
-	{
-		disk = fopen(".disk", "rb");
-		fread(&root, 1, BLOCK_SIZE, disk);
-		num_dir = root.nDirectories;
-		if(num_dir == 0)
-			{ fclose(disk); return 0; }// Immediately return if root is empty
-
-		// Print out all directories
-		int i,	// Loop counter
-			max = num_dir;		
-		for(i = 0; i < max; i++)
-			filler(buf, root.directories[i].dname, NULL, 0);
+	int is_root = strcmp(path, "/") == 0;
+	int count = 0; // Entries besides . and ..
 
-		fclose(disk);
-		return 0;
+	if (read_root() == 0)
+	{
+		if (is_root) count = num_dir;
+		else
+		{
+			// Check if the directory exists, its block is in the root
+			int i;
+			for(i = 0; i < num_dir; i++)
+				if(strcmp(root.directories[i].dname, directory) == 0) break;
+			if(i == num_dir || read_dir(root.directories[i].nStartBlock) != 0)
+				return -ENOENT; // Directory doesn't exist
+			count = de.nFiles;
+		}
 	}
+	else if (!is_root) return -ENOENT;
 
-	disk = fopen(".disk", "rb");
-	fread(&root, 1, BLOCK_SIZE, disk);
+	// Don't trust the counts on disk past the end of the block
+	if (count < 0) count = 0;
+	if (count > (int) (is_root ? MAX_DIRS_IN_ROOT : MAX_FILES_IN_DIR))
+		count = is_root ? MAX_DIRS_IN_ROOT : MAX_FILES_IN_DIR;
 
-	// Check if the directory exists
-	int max = root.nDirectories;
-	int i;
-	for(i = 0; i < max; i++)
-	{ 
-		if(strcmp(root.directories[i].dname, directory) == 0)
+	struct stat st;
+	char fullname[MAX_FILENAME + MAX_EXTENSION + 2];
+	off_t n;
+	for(n = offset; n < count + 2; n++)
+	{
+		if(n < 2)
 		{
-			cs1550_directory_entry dir;
-			fseek(disk, (i*BLOCK_SIZE), SEEK_CUR);
-			fread(&dir, 1, BLOCK_SIZE, disk);
-			char fullname[14]; fullname[0]='\0';
-			max = dir.nFiles;
-			for(i = 0; i < max; i++)
-			{
-				strcpy(fullname,dir.files[i].fname);
-				strcat(fullname, ".");
-				strcat(fullname, dir.files[i].fext);
-				filler(buf, fullname, NULL, 0);
-				fullname[0]='\0';
-			}
-
-			fclose(disk);
-			return 0;
+			strcpy(fullname, n == 0 ? "." : "..");
+			fill_stat(&st, -1);
 		}
+		else if(is_root)
+		{
+			strcpy(fullname, root.directories[n - 2].dname);
+			fill_stat(&st, -1);
+		}
+		else
+		{
+			strcpy(fullname, de.files[n - 2].fname);
+			strcat(fullname, ".");
+			strcat(fullname, de.files[n - 2].fext);
+			fill_stat(&st, de.files[n - 2].fsize);
+		}
+		if(filler(buf, fullname, &st, n + 1)) break; // Buffer full
 	}
 
-	fclose(disk);
-	return -ENOENT; // Directory doesn't exist
+	return 0;
 }
 
 /* 
@@ -309,7 +394,7 @@ static int cs1550_mkdir(const char *path, mode_t mode)
 	if (strlen(directory) > MAX_FILENAME) return -ENAMETOOLONG;
 
 	
-	disk = fopen(".disk", "r+b");
+	disk = open_disk();
 	fread(&root, 1, BLOCK_SIZE, disk);
 	num_dir = root.nDirectories;
 	// If creating the first directory
@@ -416,7 +501,7 @@ static int cs1550_mknod(const char *path, mode_t mode, dev_t dev)
 	if(len>MAX_FILENAME || strlen(extension)> MAX_EXTENSION ||
 		strlen(directory)>MAX_FILENAME) return -ENAMETOOLONG;
 
-	disk = fopen(".disk", "r+b");
+	disk = open_disk();
 	fread(&root, 1, BLOCK_SIZE, disk);
 	num_dir = root.nDirectories;
 
@@ -616,7 +701,7 @@ static int cs1550_write(const char *path, const char *buf, size_t size,
 	//write data
 	//set size (should be same as input) and return, or error
 
-	disk = fopen(".disk", "r+b");
+	disk = open_disk();
 	// Get the directory from .disk
 	directory_num++; // Index starts from 0, add 1 to get position on .disk
 	fseek(disk, directory_num*BLOCK_SIZE, SEEK_CUR);